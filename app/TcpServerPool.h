@@ -10,9 +10,12 @@
 
 #include <find_object/FindObject.h>
 #include <find_object/TcpServer.h>
+#include <find_object/DetectionCache.h>
+#include <find_object/Settings.h>
 #include <find_object/utilite/ULogger.h>
 #include <QtCore/QThread>
 #include <QtCore/QSemaphore>
+#include <QtCore/QAtomicInt>
 
 class FindObjectWorker : public QObject
 {
@@ -23,11 +26,16 @@ public:
 			find_object::FindObject * sharedFindObject,
 			QSemaphore * sharedSemaphore,
 			int maxSemaphoreResources,
+			find_object::DetectionCache * sharedCache = 0,
+			QAtomicInt * sharedPendingRequests = 0,
 			QObject * parent = 0) :
 		QObject(parent),
 		sharedFindObject_(sharedFindObject),
 		sharedSemaphore_(sharedSemaphore),
-		maxSemaphoreResources_(maxSemaphoreResources)
+		maxSemaphoreResources_(maxSemaphoreResources),
+		sharedCache_(sharedCache),
+		sharedPendingRequests_(sharedPendingRequests),
+		pendingRequests_(0)
 	{
 		UASSERT(sharedFindObject != 0);
 		UASSERT(sharedSemaphore != 0);
@@ -39,18 +47,37 @@ public Q_SLOTS:
 	{
 		sharedSemaphore_->acquire(1);
 		UINFO("Thread %p detecting...", (void *)this->thread());
-		find_object::DetectionInfo info;
-		sharedFindObject_->detect(image, info);
+		// TCP clients only receive the detected objects, no need for heavy fields
+		QSharedPointer<find_object::DetectionInfo> info(new find_object::DetectionInfo());
+		if(sharedPendingRequests_)
+		{
+			sharedFindObject_->setPendingFrames(sharedPendingRequests_->fetchAndAddOrdered(0));
+		}
+		sharedFindObject_->detect(image, *info, find_object::DetectionInfo::kFieldNone);
 		Q_EMIT objectsFound(info);
 		sharedSemaphore_->release(1);
 	}
 
+	// Requests buffered by the server of this thread, summed over all threads
+	void setPendingRequests(int pendingRequests)
+	{
+		if(sharedPendingRequests_)
+		{
+			sharedPendingRequests_->fetchAndAddOrdered(pendingRequests - pendingRequests_);
+		}
+		pendingRequests_ = pendingRequests;
+	}
+
 	void addObjectAndUpdate(const cv::Mat & image, int id, const QString & filePath)
 	{
 		//block everyone!
 		sharedSemaphore_->acquire(maxSemaphoreResources_);
 		UINFO("Thread %p adding object %d (%s)...", (void *)this->thread(), id, filePath.toStdString().c_str());
 		sharedFindObject_->addObjectAndUpdate(image, id, filePath);
+		if(sharedCache_)
+		{
+			sharedCache_->invalidate(); // catalog changed
+		}
 		sharedSemaphore_->release(maxSemaphoreResources_);
 	}
 	void removeObjectAndUpdate(int id)
@@ -59,16 +86,23 @@ public Q_SLOTS:
 		sharedSemaphore_->acquire(maxSemaphoreResources_);
 		UINFO("Thread %p removing object %d...", (void *)this->thread(), id);
 		sharedFindObject_->removeObjectAndUpdate(id);
+		if(sharedCache_)
+		{
+			sharedCache_->invalidate(); // catalog changed
+		}
 		sharedSemaphore_->release(maxSemaphoreResources_);
 	}
 
 Q_SIGNALS:
-	void objectsFound(const find_object::DetectionInfo &);
+	void objectsFound(const find_object::DetectionInfoPtr &);
 
 private:
 	find_object::FindObject * sharedFindObject_; //shared findobject
 	QSemaphore * sharedSemaphore_;
 	int maxSemaphoreResources_;
+	find_object::DetectionCache * sharedCache_; // detections cached by the TCP servers
+	QAtomicInt * sharedPendingRequests_; // requests buffered by all TCP servers
+	int pendingRequests_; // requests buffered by the TCP server of this thread
 };
 
 class TcpServerPool : public QObject
@@ -76,13 +110,21 @@ class TcpServerPool : public QObject
 	Q_OBJECT;
 public:
 	TcpServerPool(find_object::FindObject * sharedFindObject, int threads, int port) :
-		sharedSemaphore_(threads)
+		sharedSemaphore_(threads),
+		sharedCache_(0),
+		sharedPendingRequests_(0)
 	{
 		UASSERT(sharedFindObject != 0);
 		UASSERT(threads>=1);
 
 		qRegisterMetaType<cv::Mat>("cv::Mat");
 
+		if(find_object::Settings::getGeneral_tcpCacheSize() > 0)
+		{
+			sharedCache_ = new find_object::DetectionCache(find_object::Settings::getGeneral_tcpCacheSize());
+			UINFO("Detections cached (%d entries)", find_object::Settings::getGeneral_tcpCacheSize());
+		}
+
 		threadPool_.resize(threads);
 		for(int i=0; i<threads; ++i)
 		{
@@ -92,7 +134,9 @@ public:
 					tcpServer->getHostAddress().toString().toStdString().c_str());
 
 			threadPool_[i] = new QThread(this);
-			FindObjectWorker * worker = new FindObjectWorker(sharedFindObject, &sharedSemaphore_, threads);
+			FindObjectWorker * worker = new FindObjectWorker(sharedFindObject, &sharedSemaphore_, threads, sharedCache_, &sharedPendingRequests_);
+			tcpServer->setDetectionCache(sharedCache_);
+			tcpServer->setDecodeReduction(find_object::Settings::getGeneral_tcpDecodeReduction());
 
 			tcpServer->moveToThread(threadPool_[i]);
 			 worker->moveToThread(threadPool_[i]);
@@ -100,7 +144,8 @@ public:
 			connect(threadPool_[i], SIGNAL(finished()), worker, SLOT(deleteLater()));
 
 			// connect stuff:
-			QObject::connect(worker, SIGNAL(objectsFound(find_object::DetectionInfo)), tcpServer, SLOT(publishDetectionInfo(find_object::DetectionInfo)));
+			QObject::connect(worker, SIGNAL(objectsFound(find_object::DetectionInfoPtr)), tcpServer, SLOT(publishDetectionInfo(find_object::DetectionInfoPtr)));
+			QObject::connect(tcpServer, SIGNAL(pendingRequests(int)), worker, SLOT(setPendingRequests(int)));
 			QObject::connect(tcpServer, SIGNAL(detectObject(const cv::Mat &)), worker, SLOT(detect(const cv::Mat &)));
 			QObject::connect(tcpServer, SIGNAL(addObject(const cv::Mat &, int, const QString &)), worker, SLOT(addObjectAndUpdate(const cv::Mat &, int, const QString &)));
 			QObject::connect(tcpServer, SIGNAL(removeObject(int)), worker, SLOT(removeObjectAndUpdate(int)));
@@ -115,11 +160,14 @@ public:
 			threadPool_[i]->quit();
 			threadPool_[i]->wait();
 		}
+		delete sharedCache_;
 	}
 
 private:
 	QVector<QThread*> threadPool_;
 	QSemaphore sharedSemaphore_;
+	find_object::DetectionCache * sharedCache_;
+	QAtomicInt sharedPendingRequests_; // requests buffered by all TCP servers
 };
 
 
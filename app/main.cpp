@@ -604,7 +604,7 @@ int main(int argc, char* argv[])
 			QTime time;
 			time.start();
 			find_object::DetectionInfo info;
-			findObject->detect(scene, info);
+			findObject->detect(scene, info, find_object::DetectionInfo::kFieldMatches); // matches are written in JSON
 
 			if(info.objDetected_.size() > 1)
 			{
@@ -638,7 +638,9 @@ int main(int argc, char* argv[])
 				camera = new find_object::Camera();
 
 				// [Camera] ---Image---> [FindObject]
-				QObject::connect(camera, SIGNAL(imageReceived(const cv::Mat &)), findObject, SLOT(detect(const cv::Mat &)));
+				QObject::connect(camera, SIGNAL(imageReceived(const cv::Mat &, int)), findObject, SLOT(detect(const cv::Mat &, int)));
+				QObject::connect(camera, SIGNAL(streamStarted(int)), findObject, SLOT(resetStream(int)));
+				QObject::connect(camera, SIGNAL(imagesPending(int)), findObject, SLOT(setPendingFrames(int)));
 				QObject::connect(camera, SIGNAL(finished()), &app, SLOT(quit()));
 
 				if(!camera->start())
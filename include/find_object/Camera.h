@@ -38,6 +38,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace find_object {
 
 class CameraTcpServer;
+class ImageDecoder;
+class FrameRing;
+class CaptureThread;
+class ImagesReadAhead;
+class VideoReadAhead;
 
 class FINDOBJECT_EXP Camera : public QObject {
 	Q_OBJECT
@@ -53,10 +58,17 @@ public:
 	int getTotalFrames();
 	int getCurrentFrameIndex();
 	int getPort();
+	int imagesBuffered() const; // images waiting in the input queue (TCP)
+	int framesCaptured() const; // by the capture thread (see "Camera/captureThread")
+	int framesDropped() const; // frames captured but not processed
+	int lastStreamId() const {return lastStreamId_;} // TCP client of the last image, -1 for other sources
 	void moveToFrame(int frame);
 
 Q_SIGNALS:
 	void imageReceived(const cv::Mat & image);
+	void imageReceived(const cv::Mat & image, int streamId); // streamId: TCP client, -1 for other sources
+	void streamStarted(int streamId); // a new TCP client reuses this stream ID (see FindObject::resetStream())
+	void imagesPending(int images); // images buffered, emitted before imageReceived() (see FindObject::setPendingFrames())
 	void finished();
 
 public Q_SLOTS:
@@ -73,6 +85,15 @@ private:
 	QList<std::string> images_;
 	unsigned int currentImageIndex_;
 	CameraTcpServer * cameraTcpServer_;
+	ImageDecoder * decoder_; // directory of images
+	FrameRing * ring_;
+	CaptureThread * captureThread_; // camera device read in its own thread
+	int framesDropped_; // last count logged
+	ImagesReadAhead * imagesReadAhead_; // directory of images decoded ahead
+	VideoReadAhead * videoReadAhead_; // video file decoded ahead
+	int videoTotalFrames_; // video decoded ahead
+	int videoFrameIndex_; // video decoded ahead
+	int lastStreamId_; // TCP client of the last image
 };
 
 } // namespace find_object
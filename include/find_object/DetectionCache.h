@@ -0,0 +1,79 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DETECTIONCACHE_H_
+#define DETECTIONCACHE_H_
+
+#include "find_object/FindObjectExp.h" // DLL export/import defines
+
+#include "find_object/DetectionInfo.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+
+namespace find_object {
+
+// LRU cache of detections keyed by a hash of the received image bytes
+// (General/tcpCacheSize), for clients resending the same images. Entries
+// are valid only for the catalog version they were computed with: call
+// invalidate() when objects are added or removed. Thread-safe, can be
+// shared by many TcpServer.
+class FINDOBJECT_EXP DetectionCache
+{
+public:
+	DetectionCache(int capacity);
+	virtual ~DetectionCache() {}
+
+	static QByteArray hash(const char * data, int size);
+
+	int version() const;
+	// Clear the cache and increment the catalog version
+	void invalidate();
+
+	// Count a hit or a miss
+	bool get(const QByteArray & hash, DetectionInfo & info);
+	// Ignored if the catalog changed since version
+	void insert(const QByteArray & hash, int version, const DetectionInfo & info);
+
+	int hits() const;
+	int misses() const;
+	float hitRate() const;
+
+private:
+	mutable QMutex mutex_;
+	int capacity_;
+	int version_;
+	QHash<QByteArray, DetectionInfo> entries_;
+	QList<QByteArray> order_; // most recently used first
+	int hits_;
+	int misses_;
+};
+
+} // namespace find_object
+
+#endif /* DETECTIONCACHE_H_ */
@@ -28,6 +28,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define DETECTIONINFO_H_
 
 #include <QtCore/QMultiMap>
+#include <QtCore/QSharedPointer>
 #include <QtGui/QTransform>
 #include <QtCore/QSize>
 #include <QtCore/QString>
@@ -47,7 +48,9 @@ public:
 		kTimeIndexing,
 		kTimeMatching,
 		kTimeHomography,
-		kTimeTotal
+		kTimeTotal,
+		kTimeShortlist,
+		kTimeRetrieval
 	};
 	enum RejectedCode{
 		kRejectedUndef,
@@ -57,15 +60,68 @@ public:
 		kRejectedAllInliers,
 		kRejectedNotValid,
 		kRejectedCornersOutside,
-		kRejectedByAngle
+		kRejectedByAngle,
+		kRejectedShortlist,
+		kRejectedNotEvaluated // not verified, deadline or early termination
 	};
+	// Heavy fields, only populated when requested (see FindObject::addRequiredFields())
+	enum Field{
+		kFieldNone             = 0x00,
+		kFieldSceneKeypoints   = 0x01, // sceneKeypoints_
+		kFieldSceneDescriptors = 0x02, // sceneDescriptors_
+		kFieldSceneWords       = 0x04, // sceneWords_
+		kFieldMatches          = 0x08, // objMatches_
+		kFieldInliers          = 0x10, // objDetectedInliers_ and objDetectedOutliers_
+		kFieldRejected         = 0x20, // rejectedInliers_ and rejectedOutliers_
+		kFieldAll              = 0x3F
+	};
+
+	// Correspondence between an object's descriptor and a scene's descriptor
+	struct Match
+	{
+		Match() :
+			objectIndex(-1),
+			sceneIndex(-1),
+			distance(-1.0f)
+		{}
+		Match(int objectIndex, int sceneIndex, float distance) :
+			objectIndex(objectIndex),
+			sceneIndex(sceneIndex),
+			distance(distance)
+		{}
+		int objectIndex; // ObjectDescriptorIndex
+		int sceneIndex;  // SceneDescriptorIndex
+		float distance;
+	};
+	typedef std::vector<Match> Matches;
 
 public:
 	DetectionInfo() :
 		minMatchedDistance_(-1),
-		maxMatchedDistance_(-1)
+		maxMatchedDistance_(-1),
+		fields_(kFieldAll),
+		partial_(false),
+		reused_(false),
+		streamId_(-1)
 	{}
 
+	// Compatibility accessors: same matches in the Map< ObjectDescriptorIndex, SceneDescriptorIndex > format
+	QMap<int, QMultiMap<int, int> > matches() const {return toMultiMaps(objMatches_);}
+	QMultiMap<int, QMultiMap<int, int> > objDetectedInliers() const {return toMultiMaps(objDetectedInliers_);}
+	QMultiMap<int, QMultiMap<int, int> > objDetectedOutliers() const {return toMultiMaps(objDetectedOutliers_);}
+	QMultiMap<int, QMultiMap<int, int> > rejectedInliers() const {return toMultiMaps(rejectedInliers_);}
+	QMultiMap<int, QMultiMap<int, int> > rejectedOutliers() const {return toMultiMaps(rejectedOutliers_);}
+
+	static QMultiMap<int, int> toMultiMap(const Matches & matches)
+	{
+		QMultiMap<int, int> map;
+		for(unsigned int i=0; i<matches.size(); ++i)
+		{
+			map.insert(matches[i].objectIndex, matches[i].sceneIndex);
+		}
+		return map;
+	}
+
 public:
 	// Those maps have the same size
 	QMultiMap<int, QTransform> objDetected_;
@@ -73,24 +129,56 @@ public:
 	QMultiMap<int, QString > objDetectedFilePaths_; // Object ID <filename> match the number of detected objects
 	QMultiMap<int, int> objDetectedInliersCount_; // ObjectID <count> match the number of detected objects
 	QMultiMap<int, int> objDetectedOutliersCount_; // ObjectID <count> match the number of detected objects
-	QMultiMap<int, QMultiMap<int, int> > objDetectedInliers_; // ObjectID Map< ObjectDescriptorIndex, SceneDescriptorIndex >, match the number of detected objects
-	QMultiMap<int, QMultiMap<int, int> > objDetectedOutliers_; // ObjectID Map< ObjectDescriptorIndex, SceneDescriptorIndex >, match the number of detected objects
+	QMultiMap<int, Matches> objDetectedInliers_; // ObjectID Matches, match the number of detected objects
+	QMultiMap<int, Matches> objDetectedOutliers_; // ObjectID Matches, match the number of detected objects
 
 	QMap<TimeStamp, float> timeStamps_;
+	QMap<QString, float> statistics_; // <name, value>
 	std::vector<cv::KeyPoint> sceneKeypoints_;
 	cv::Mat sceneDescriptors_;
 	QMultiMap<int, int> sceneWords_;
-	QMap<int, QMultiMap<int, int> > matches_; // ObjectID Map< ObjectDescriptorIndex, SceneDescriptorIndex >, match the number of objects
+	QMap<int, Matches> objMatches_; // ObjectID Matches, only objects with at least one match
 
 	// Those maps have the same size
-	QMultiMap<int, QMultiMap<int, int> > rejectedInliers_; // ObjectID Map< ObjectDescriptorIndex, SceneDescriptorIndex >
-	QMultiMap<int, QMultiMap<int, int> > rejectedOutliers_; // ObjectID Map< ObjectDescriptorIndex, SceneDescriptorIndex >
+	QMultiMap<int, Matches> rejectedInliers_; // ObjectID Matches
+	QMultiMap<int, Matches> rejectedOutliers_; // ObjectID Matches
 	QMultiMap<int, RejectedCode> rejectedCodes_; // ObjectID rejected code
 
 	float minMatchedDistance_;
 	float maxMatchedDistance_;
+
+	int fields_; // Field flags of the heavy fields populated
+	bool partial_; // deadline reached, some objects were not evaluated (see kRejectedNotEvaluated)
+	bool reused_; // scene unchanged, detection of a previous frame returned (see General/frameGate)
+	int streamId_; // TCP camera client the scene comes from (see Camera/maxStreams), -1 for other sources
+
+private:
+	static QMap<int, QMultiMap<int, int> > toMultiMaps(const QMap<int, Matches> & in)
+	{
+		QMap<int, QMultiMap<int, int> > out;
+		for(QMap<int, Matches>::const_iterator iter=in.constBegin(); iter!=in.constEnd(); ++iter)
+		{
+			out.insert(iter.key(), toMultiMap(iter.value()));
+		}
+		return out;
+	}
+	static QMultiMap<int, QMultiMap<int, int> > toMultiMaps(const QMultiMap<int, Matches> & in)
+	{
+		// inserted from the end to keep the same order for values with the same key
+		QMultiMap<int, QMultiMap<int, int> > out;
+		QMultiMap<int, Matches>::const_iterator iter=in.constEnd();
+		while(iter!=in.constBegin())
+		{
+			--iter;
+			out.insert(iter.key(), toMultiMap(iter.value()));
+		}
+		return out;
+	}
 };
 
+// Detection results are shared between consumers without being copied
+typedef QSharedPointer<const DetectionInfo> DetectionInfoPtr;
+
 inline QDataStream & operator<<(QDataStream &out, const DetectionInfo & info)
 {
 	out << quint32(info.objDetected_.size());
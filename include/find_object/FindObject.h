@@ -48,6 +48,10 @@ namespace find_object {
 
 class ObjSignature;
 class Vocabulary;
+class Vlad;
+class SearchPlanner;
+class LatencyController;
+class StreamStates;
 class Feature2D;
 
 class FINDOBJECT_EXP FindObject : public QObject
@@ -79,7 +83,13 @@ public:
 	void removeObject(int id);
 	void removeAllObjects();
 
-	bool detect(const cv::Mat & image, find_object::DetectionInfo & info) const;
+	// maxLatencyMs: time budget, -1 means "General/maxLatencyMs", 0 means no deadline
+	bool detect(const cv::Mat & image, find_object::DetectionInfo & info, int fields = DetectionInfo::kFieldAll, int maxLatencyMs = -1) const;
+
+	// Heavy fields (DetectionInfo::Field) populated in results emitted by objectsFound()
+	void addRequiredFields(int fields) {requiredFields_ |= fields;}
+	void setRequiredFields(int fields) {requiredFields_ = fields;}
+	int requiredFields() const {return requiredFields_;}
 
 	void updateDetectorExtractor();
 	void updateObjects(const QList<int> & ids = QList<int>());
@@ -92,22 +102,35 @@ public Q_SLOTS:
 	void addObjectAndUpdate(const cv::Mat & image, int id=0, const QString & filePath = QString());
 	void removeObjectAndUpdate(int id);
 	void detect(const cv::Mat & image); // emit objectsFound()
+	void detect(const cv::Mat & image, int streamId); // emit objectsFound(), DetectionInfo::streamId_ set
+	void resetStream(int streamId); // frame gate and incremental extraction states of a new stream
+	void setPendingFrames(int pendingFrames); // images waiting in the input queue (see "General/targetLatencyMs")
 
 Q_SIGNALS:
-	void objectsFound(const find_object::DetectionInfo &);
+	void objectsFound(const find_object::DetectionInfoPtr &);
 
 private:
 	void clearVocabulary();
+	void updateInvertedIndex();
+	void updateGlobalDescriptors(bool retrain);
 
 private:
 	QMap<int, ObjSignature*> objects_;
 	Vocabulary * vocabulary_;
 	QMap<int, cv::Mat> objectsDescriptors_;
+	Vlad * vlad_;
+	SearchPlanner * planner_; // thread-safe
+	LatencyController * latencyController_; // thread-safe
+	StreamStates * streams_; // thread-safe, frame gate and incremental extraction of each scene stream
+	cv::Mat globalDescriptors_; // one VLAD vector per row
+	std::vector<int> globalDescriptorsIds_; // object ID of each row of globalDescriptors_
 	QMap<int, int> dataRange_; // <last id of object's descriptor, id>
 	Feature2D * detector_;
 	Feature2D * extractor_;
 	bool sessionModified_;
 	bool keepImagesInRAM_;
+	int requiredFields_;
+	cv::Size lastSceneSize_; // to precompute objects' optical flow pyramids
 };
 
 } // namespace find_object
@@ -113,7 +113,7 @@ private Q_SLOTS:
 	void rectHovered(int objId);
 
 Q_SIGNALS:
-	void objectsFound(const find_object::DetectionInfo &);
+	void objectsFound(const find_object::DetectionInfoPtr &);
 
 private:
 	bool loadSettings(const QString & path);
@@ -108,14 +108,26 @@ class FINDOBJECT_EXP Settings
 	PARAMETER(Camera, 4imageRate, double, 10.0, "Image rate in Hz (0 Hz means as fast as possible)."); // Hz
 	PARAMETER(Camera, 5mediaPath, QString, "", "Video file or directory of images. If set, the camera is not used. See General->videoFormats and General->imageFormats for available formats.");
 	PARAMETER(Camera, 6useTcpCamera, bool, false, "Use TCP/IP input camera.");
-	PARAMETER(Camera, 8port, int, 0, "The images server's port when useTcpCamera is checked. Only one client at the same time is allowed.");
-	PARAMETER(Camera, 9queueSize, int, 1, "Maximum images buffered from TCP. If 0, all images are buffered.");
+	PARAMETER(Camera, 8port, int, 0, "The images server's port when useTcpCamera is checked. Many clients can stream images at the same time (see \"Camera/maxStreams\").");
+	PARAMETER(Camera, 9queueSize, int, 1, "Maximum images buffered from each TCP client. If 0, all images are buffered.");
+	PARAMETER(Camera, maxStreams, int, 0, "Maximum TCP clients streaming images at the same time, their images are processed in turn (round-robin). 0 means no limit.");
+	PARAMETER(Camera, readAhead, int, 0, "Directory of images or video file: X images are decoded ahead while the current one is processed (on \"Camera/readAheadThreads\" threads for images, on one thread for a video). 0 means images are decoded when they are processed.");
+	PARAMETER(Camera, readAheadThreads, int, 2, "Threads decoding images of a directory ahead (see \"Camera/readAhead\").");
+	PARAMETER(Camera, videoStride, int, 1, "Video file with \"Camera/readAhead\": only one frame every X frames is decoded, the others are skipped.");
+	PARAMETER(Camera, captureThread, bool, false, "Camera devices are read in their own thread into a ring buffer (see \"Camera/captureRingSize\"). The newest frame is always processed, older frames are dropped when the detection is slower than the camera.");
+	PARAMETER(Camera, captureRingSize, int, 4, "Frames buffered by the capture thread (see \"Camera/captureThread\").");
+	PARAMETER(Camera, decodeGrayscale, bool, false, "Images from a directory or from TCP are decoded directly to grayscale (the scene is then shown in grayscale). When \"Camera/2imageWidth\" and \"Camera/3imageHeight\" are set, JPEG images are also decoded at 1/2, 1/4 or 1/8 of their resolution when it is still larger than the size requested, whether or not this option is set.");
 
 	//List format : [Index:item0;item1;item3;...]
 
 	PARAMETER_COND(Feature2D, 1Detector, QString, FINDOBJECT_NONFREE, "7:Dense;Fast;GFTT;MSER;ORB;SIFT;Star;SURF;BRISK;AGAST;KAZE;AKAZE" , "4:Dense;Fast;GFTT;MSER;ORB;SIFT;Star;SURF;BRISK;AGAST;KAZE;AKAZE", "Keypoint detector.");
 	PARAMETER_COND(Feature2D, 2Descriptor, QString, FINDOBJECT_NONFREE, "3:Brief;ORB;SIFT;SURF;BRISK;FREAK;KAZE;AKAZE;LUCID;LATCH;DAISY", "1:Brief;ORB;SIFT;SURF;BRISK;FREAK;KAZE;AKAZE;LUCID;LATCH;DAISY", "Keypoint descriptor.");
-	PARAMETER(Feature2D, 3MaxFeatures, int, 0, "Maximum features per image. If the number of features extracted is over this threshold, only X features with the highest response are kept. 0 means all features are kept.");
+	PARAMETER(Feature2D, 3MaxFeatures, int, 0, "Maximum features per image. If the number of features extracted is over this threshold, only X features are kept (see \"Feature2D/3MaxFeaturesSelection\"). 0 means all features are kept.");
+	PARAMETER(Feature2D, 3MaxFeaturesSelection, QString, "0:Response;Grid;ANMS", "Selection of the features kept when over \"Feature2D/3MaxFeatures\". Response: highest responses. Grid: highest responses with an equal quota per cell of a grid (see \"Feature2D/3MaxFeaturesGridSize\"). ANMS: adaptive non-maximal suppression, features are kept spatially uniform by suppressing weaker features around stronger ones.");
+	PARAMETER(Feature2D, 3MaxFeaturesGridSize, int, 8, "Grid selection: the image is divided in X by X cells.");
+	PARAMETER(Feature2D, 3AdaptiveThreshold, bool, false, "Adapt the detector threshold frame to frame so that the number of raw keypoints detected stays near \"Feature2D/3AdaptiveThresholdTarget\". Used with Fast, AGAST, BRISK and SURF detectors (not GPU versions). Thresholds are kept per image size.");
+	PARAMETER(Feature2D, 3AdaptiveThresholdTarget, int, 0, "Target of raw keypoints detected per image. 0 means 2 times \"Feature2D/3MaxFeatures\".");
+	PARAMETER(Feature2D, 3AdaptiveThresholdTiles, int, 4, "Fast and AGAST: the image is divided in X by X tiles, each one with its own threshold. BRISK and SURF use a single threshold for the whole image.");
 	PARAMETER(Feature2D, 4Affine, bool, false, "(ASIFT) Extract features on multiple affine transformations of the image.");
 	PARAMETER(Feature2D, 5AffineCount, int, 6, "(ASIFT) Higher the value, more affine transformations will be done.");
 	PARAMETER(Feature2D, 6SubPix, bool, false, "Refines the corner locations. With SIFT/SURF, features are already subpixel, so no need to activate this.");
@@ -228,7 +240,7 @@ class FINDOBJECT_EXP Settings
 	PARAMETER(Feature2D, DAISY_interpolation, bool, true, "Switch to disable interpolation for speed improvement at minor quality loss.");
 	PARAMETER(Feature2D, DAISY_use_orientation, bool, false, "Sample patterns using keypoints orientation, disabled by default.");
 
-	PARAMETER_COND(NearestNeighbor, 1Strategy, QString, FINDOBJECT_NONFREE, "1:Linear;KDTree;KMeans;Composite;Autotuned;Lsh;BruteForce", "6:Linear;KDTree;KMeans;Composite;Autotuned;Lsh;BruteForce", "Nearest neighbor strategy.");
+	PARAMETER_COND(NearestNeighbor, 1Strategy, QString, FINDOBJECT_NONFREE, "1:Linear;KDTree;KMeans;Composite;Autotuned;Lsh;BruteForce;VocabularyTree", "6:Linear;KDTree;KMeans;Composite;Autotuned;Lsh;BruteForce;VocabularyTree", "Nearest neighbor strategy.");
 	PARAMETER_COND(NearestNeighbor, 2Distance_type, QString, FINDOBJECT_NONFREE, "0:EUCLIDEAN_L2;MANHATTAN_L1;MINKOWSKI;MAX;HIST_INTERSECT;HELLINGER;CHI_SQUARE_CS;KULLBACK_LEIBLER_KL;HAMMING", "1:EUCLIDEAN_L2;MANHATTAN_L1;MINKOWSKI;MAX;HIST_INTERSECT;HELLINGER;CHI_SQUARE_CS;KULLBACK_LEIBLER_KL;HAMMING", "Distance type.");
 	PARAMETER(NearestNeighbor, 3nndrRatioUsed, bool, true, "Nearest neighbor distance ratio approach to accept the best match.");
 	PARAMETER(NearestNeighbor, 4nndrRatio, float, 0.8f, "Nearest neighbor distance ratio.");
@@ -265,6 +277,10 @@ class FINDOBJECT_EXP Settings
 	PARAMETER(NearestNeighbor, Lsh_key_size, int, 20, "The size of the hash key in bits (between 10 and 20 usually).");
 	PARAMETER(NearestNeighbor, Lsh_multi_probe_level, int, 2, "The number of bits to shift to check for neighboring buckets (0 is regular LSH, 2 is recommended).");
 
+	PARAMETER(NearestNeighbor, VocabularyTree_branching, int, 10, "Branching factor of the hierarchical k-means vocabulary tree (k-majority for binary descriptors).");
+	PARAMETER(NearestNeighbor, VocabularyTree_depth, int, 6, "Maximum depth of the vocabulary tree. Descriptors are quantized by greedy descent from the root, then compared only to the words of the leaf reached.");
+	PARAMETER(NearestNeighbor, VocabularyTree_iterations, int, 10, "Maximum number of clustering iterations at each node of the vocabulary tree.");
+
 	PARAMETER(General, autoStartCamera, bool, false, "Automatically start the camera when the application is opened.");
 	PARAMETER(General, autoUpdateObjects, bool, true, "Automatically update objects on every parameter changes, otherwise you would need to press \"Update objects\" on the objects panel.");
 	PARAMETER(General, nextObjID, uint, 1, "Next object ID to use.");
@@ -274,9 +290,35 @@ class FINDOBJECT_EXP Settings
 	PARAMETER(General, invertedSearch, bool, true, "Instead of matching descriptors from the objects to those in a vocabulary created with descriptors extracted from the scene, we create a vocabulary from all the objects' descriptors and we match scene's descriptors to this vocabulary. It is the inverted search mode.");
 	PARAMETER(General, controlsShown, bool, false, "Show play/image seek controls (useful with video file and directory of images modes).");
 	PARAMETER(General, threads, int, 1, "Number of threads used for objects matching and homography computation. 0 means as many threads as objects. On InvertedSearch mode, multi-threading has only effect on homography computation.");
-	PARAMETER(General, multiDetection, bool, false, "Multiple detection of the same object.");
+	PARAMETER(General, multiDetection, bool, false, "Multiple detection of the same object. All instances of an object are searched in the same thread: after each homography found, its inliers are removed and a new homography is estimated with the remaining matches.");
 	PARAMETER(General, multiDetectionRadius, int, 30, "Ignore detection of the same object in X pixels radius of the previous detections.");
+	PARAMETER(General, maxDetections, int, 0, "Stop verifying candidates (homographies) when X objects are detected. Candidates are verified best first (expected objects, then most matches) by batches of \"General/threads\", detections of the last batch are all kept. 0 means no limit.");
+	PARAMETER(General, maxLatencyMs, int, 0, "(ms) Detection deadline. From the measured cost of the previous frames, the number of scene features and the search checks are reduced to keep time for verification, then candidates are not verified anymore if the next batch of homographies would finish too late. The detection is then marked partial and candidates not verified are rejected as not evaluated. 0 means no deadline.");
+	PARAMETER(General, targetLatencyMs, int, 0, "(ms) Target detection latency. A feedback controller adjusts the maximum features extracted from the scene (between \"General/targetLatencyMinFeatures\" and \"Feature2D/3MaxFeatures\") and the affine count (between 1 and \"Feature2D/5AffineCount\" when \"Feature2D/4Affine\" is on) to track it. When images are waiting in the input queue, the target is divided by the number of images to process. 0 means disabled.");
+	PARAMETER(General, targetLatencyMinFeatures, int, 200, "Minimum features extracted from the scene when \"General/targetLatencyMs\" is set.");
+	PARAMETER(General, incrementalExtraction, bool, false, "For fixed cameras: the scene is compared block by block to a reference frame, features are extracted only in the changed blocks (dilated by \"General/incrementalMargin\") and the features of the unchanged blocks are reused from the reference. Not used with \"Feature2D/4Affine\".");
+	PARAMETER(General, incrementalBlockSize, int, 32, "(pixels) Size of the blocks compared to the reference frame (see \"General/incrementalExtraction\").");
+	PARAMETER(General, incrementalThreshold, float, 8.0f, "Mean absolute intensity difference with the reference frame over which a block has changed (see \"General/incrementalExtraction\").");
+	PARAMETER(General, incrementalMargin, int, 32, "(pixels) Guard margin around changed blocks, features inside are extracted again. It should cover the radius of the descriptor's patch (see \"General/incrementalExtraction\").");
+	PARAMETER(General, incrementalMaxChangedRatio, float, 0.5f, "When the ratio of the image to extract again is over this value, the whole image is extracted (see \"General/incrementalExtraction\").");
+	PARAMETER(General, incrementalRefreshFrames, int, 100, "The whole image is extracted every X frames (see \"General/incrementalExtraction\"). 0 means never.");
+	PARAMETER(General, frameGate, bool, false, "Motion and duplicate frame gate: a small grayscale thumbnail of the scene is compared to the one of the last detection. If the mean absolute difference is under \"General/frameGateThreshold\", the last detection is returned again (marked reused) without running the detection. Useful with static cameras or clients sending the same image.");
+	PARAMETER(General, frameGateSize, int, 32, "(pixels) Width of the thumbnail compared (see \"General/frameGate\").");
+	PARAMETER(General, frameGateThreshold, float, 2.0f, "Mean absolute intensity difference between the thumbnails under which the scene is unchanged (see \"General/frameGate\").");
+	PARAMETER(General, frameGateMaxReused, int, 0, "Maximum consecutive times the same detection is reused, the detection is then done again (see \"General/frameGate\"). 0 means no limit.");
+	PARAMETER(General, expectedObjects, QString, "", "IDs of the objects searched, separated by commas. They are verified first and verification stops when all of them are detected. Empty means all objects.");
+	PARAMETER(General, shortlist, bool, false, "On inverted search mode, objects are scored with TF-IDF weighted votes of their matched words before computing homographies. Only the best candidates are verified, in descending score order.");
+	PARAMETER(General, shortlistTopK, int, 10, "Maximum number of candidates kept by the shortlist (see \"General/shortlist\"). 0 means no limit.");
+	PARAMETER(General, shortlistMinScore, float, 0.0f, "Minimum score of the candidates kept by the shortlist (see \"General/shortlist\"). The score is the sum of the inverse document frequency of the matched words divided by the square root of the number of words of the object.");
+	PARAMETER(General, autoPlan, bool, false, "Choose how descriptors are matched with a cost model calibrated from the measured indexing and matching times. On direct search (\"General/invertedSearch\" disabled), brute force matching or a nearest neighbor index over the scene is chosen for each frame. The search direction estimated the cheapest is logged when the vocabulary is updated.");
+	PARAMETER(General, stopWordsMaxFrequency, float, 0.0f, "On inverted search mode, words referred by more than this ratio of the objects (document frequency) are stop words: they are removed from the inverted index and scene's descriptors matched to them are ignored. 0 means no stop words.");
+	PARAMETER(General, globalRetrieval, bool, false, "On inverted search mode, a global descriptor (VLAD) is computed for each object and for the scene. Scene's descriptors are matched only to descriptors of the \"General/globalRetrievalTopN\" most similar objects instead of the whole vocabulary. Useful with large number of objects.");
+	PARAMETER(General, globalRetrievalTopN, int, 20, "Number of the most similar objects retrieved (see \"General/globalRetrieval\").");
+	PARAMETER(General, globalRetrievalClusters, int, 16, "Number of clusters of the VLAD codebook learned from the objects' descriptors (see \"General/globalRetrieval\").");
+	PARAMETER(General, globalRetrievalDim, int, 128, "Dimension of the global descriptors after PCA reduction (see \"General/globalRetrieval\"). 0 means no reduction.");
 	PARAMETER(General, port, int, 0, "Port on objects detected are published. If port=0, a port is chosen automatically.")
+	PARAMETER(General, tcpDecodeReduction, int, 1, "TCP service: images received for detection are decoded at 1/X of their resolution (1, 2, 4 or 8, done while decoding for JPEG), detections are scaled back to the resolution of the images received.");
+	PARAMETER(General, tcpCacheSize, int, 0, "TCP service: number of detections kept in a cache keyed by a hash of the received image bytes. Images resent by clients are not decoded and detected again, the cached detection is published. The cache is cleared when objects are added or removed. 0 means no cache.");
 	PARAMETER(General, autoScroll, bool, true, "Auto scroll to detected object in Objects panel.");
 	PARAMETER(General, vocabularyFixed, bool, false, "If the vocabulary is fixed, no new words will be added to it when adding new objects.");
 	PARAMETER(General, vocabularyIncremental, bool, false, "The vocabulary is created incrementally. When new objects are added, their descriptors are compared to those already in vocabulary to find if the visual word already exist or not. \"NearestNeighbor/nndrRatio\" and \"NearestNeighbor/minDistance\" are used to compare descriptors.");
@@ -293,6 +335,11 @@ class FINDOBJECT_EXP Settings
 	PARAMETER(Homography, maxIterations, int, 2000, "The maximum number of RANSAC iterations, 2000 is the maximum it can be.");
 	PARAMETER(Homography, confidence, double, 0.995, "Confidence level, between 0 and 1.");
 #endif
+	PARAMETER(Homography, prosac, bool, false, "Use the built-in PROSAC estimator instead of \"Homography/method\": matches are sampled by increasing descriptor distance (best matches first), so a good model is usually found in fewer iterations. \"Homography/ransacReprojThr\", \"Homography/maxIterations\" and \"Homography/confidence\" are used.");
+	PARAMETER(Homography, prosacModel, QString, "0:Homography;Affine;Similarity", "Transformation estimated by the PROSAC estimator. Models with fewer degrees of freedom need smaller samples (4, 3 or 2 matches), so fewer iterations for the same confidence.");
+	PARAMETER(Homography, prosacLocalOptimization, bool, true, "PROSAC: local optimization (LO-RANSAC), each new best model is refined by iterative least squares on its inliers.");
+	PARAMETER(Homography, prosacSprt, bool, true, "PROSAC: bad models are rejected early during verification with Wald's sequential probability ratio test (SPRT).");
+	PARAMETER(Homography, prosacSeed, int, 0, "PROSAC: seed of the random generator, results are reproducible for the same seed.");
 	PARAMETER(Homography, minimumInliers, int, 10, "Minimum inliers to accept the homography. Value must be >= 4.");
 	PARAMETER(Homography, ignoreWhenAllInliers, bool, false, "Ignore homography when all features are inliers (sometimes when the homography doesn't converge, it returns the best homography with all features as inliers).");
 	PARAMETER(Homography, rectBorderWidth, int, 4, "Homography rectangle border width.");
@@ -303,6 +350,10 @@ class FINDOBJECT_EXP Settings
 	PARAMETER(Homography, opticalFlowMaxLevel, int, 3, "0-based maximal pyramid level number; if set to 0, pyramids are not used (single level), if set to 1, two levels are used, and so on; if pyramids are passed to input then algorithm will use as many levels as pyramids have but no more than maxLevel.");
 	PARAMETER(Homography, opticalFlowIterations, int, 30, "Specifying the termination criteria of the iterative search algorithm (after the specified maximum number of iterations).");
 	PARAMETER(Homography, opticalFlowEps, float, 0.01f, "Specifying the termination criteria of the iterative search algorithm (when the search window moves by less than epsilon).");
+	PARAMETER(Homography, houghClustering, bool, false, "Pose clustering pre-filter (Lowe's generalized Hough transform). Each match votes for a coarse pose (location, scale, orientation) of the object in the scene, computed from keypoints' position, size and angle. Only consistent clusters of at least \"Homography/minimumInliers\" matches are sent to the robust estimation, each cluster as a separate instance hypothesis computed in parallel. With \"General/multiDetection\", outliers are not re-processed as clusters already separate the instances.");
+	PARAMETER(Homography, houghLocationBin, float, 0.25f, "Location bin size of the pose clustering, as a ratio of the maximum object's dimension at the predicted scale.");
+	PARAMETER(Homography, houghOrientationBin, int, 30, "(Degrees) Orientation bin size of the pose clustering. Ignored if the features don't have orientation.");
+	PARAMETER(Homography, houghScaleBin, float, 2.0f, "Scale factor between consecutive scale bins of the pose clustering (must be > 1). Ignored if the features don't have size.");
 
 public:
 	virtual ~Settings(){}
@@ -335,6 +386,7 @@ public:
 	static QString currentNearestNeighborType();
 
 	static bool isBruteForceNearestNeighbor();
+	static bool isVocabularyTreeNearestNeighbor();
 	static cv::flann::IndexParams * createFlannIndexParams();
 	static cvflann::flann_distance_t getFlannDistanceType();
 
@@ -34,10 +34,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <opencv2/opencv.hpp>
 
 #include <QtNetwork/QTcpServer>
+#include <QtCore/QByteArray>
+#include <QtCore/QList>
 
 namespace find_object {
 
 class QNetworkSession;
+class DetectionCache;
 
 class FINDOBJECT_EXP TcpServer : public QTcpServer
 {
@@ -56,8 +59,18 @@ public:
 	QHostAddress getHostAddress() const;
 	quint16 getPort() const;
 
+	// Detections published are cached for the images received with kDetectObject,
+	// detectObject() must be connected to a detector publishing back its results
+	// in the same order. Not owned, can be shared with other servers.
+	void setDetectionCache(DetectionCache * cache) {cache_ = cache;}
+	// Images received with kDetectObject are decoded in grayscale at 1/reduction
+	// of their resolution (1, 2, 4 or 8), detections published are scaled back.
+	// Same requirements than setDetectionCache().
+	void setDecodeReduction(int reduction);
+
 public Q_SLOTS:
 	void publishDetectionInfo(const find_object::DetectionInfo & info);
+	void publishDetectionInfo(const find_object::DetectionInfoPtr & info);
 
 private Q_SLOTS:
 	void addClient();
@@ -69,9 +82,32 @@ Q_SIGNALS:
 	void addObject(const cv::Mat &, int, const QString &);
 	void removeObject(int);
 	void detectObject(const cv::Mat &);
+	void pendingRequests(int); // detection requests still buffered in the sockets (estimated), emitted before detectObject()
+
+private:
+	void sendDetectionInfo(const find_object::DetectionInfo & info);
 
 private:
+	class PendingDetection
+	{
+	public:
+		PendingDetection(const QByteArray & hash = QByteArray(), int version = 0, int reduction = 1) :
+			hash(hash),
+			version(version),
+			reduction(reduction),
+			resolved(false)
+		{}
+		QByteArray hash; // empty if not cached
+		int version; // catalog version
+		int reduction;
+		bool resolved; // cached detection, sent after the detections requested before it
+		DetectionInfo info; // if resolved
+	};
+
 	QMap<int, quint64> blockSizes_;
+	DetectionCache * cache_;
+	int reduction_;
+	QList<PendingDetection> pendingDetections_; // detections waiting to be published, in order
 };
 
 } // namespace find_object
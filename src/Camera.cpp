@@ -35,13 +35,68 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QtCore/QFile>
 #include "utilite/UDirectory.h"
 #include "CameraTcpServer.h"
+#include "ImageDecoder.h"
+#include "FrameRing.h"
+#include "ReadAhead.h"
+#include <QtCore/QThread>
 
 namespace find_object {
 
+// Reads the camera device continuously, frames are pushed in the ring
+class CaptureThread : public QThread
+{
+public:
+	CaptureThread(cv::VideoCapture * capture, FrameRing * ring) :
+		capture_(capture),
+		ring_(ring),
+		stop_(0)
+	{
+		UASSERT(capture_ && ring_);
+	}
+	virtual ~CaptureThread() {}
+
+	void stop()
+	{
+		stop_.fetchAndStoreOrdered(1);
+		this->wait();
+	}
+
+protected:
+	virtual void run()
+	{
+		while(stop_.fetchAndAddOrdered(0) == 0)
+		{
+			cv::Mat img;
+			if(capture_->read(img) && !img.empty())
+			{
+				ring_->push(img.clone()); // clone required with VideoCapture::read()
+			}
+			else
+			{
+				this->msleep(10);
+			}
+		}
+	}
+
+private:
+	cv::VideoCapture * capture_;
+	FrameRing * ring_;
+	QAtomicInt stop_;
+};
+
 Camera::Camera(QObject * parent) :
 	QObject(parent),
 	currentImageIndex_(0),
-	cameraTcpServer_(0)
+	cameraTcpServer_(0),
+	decoder_(new ImageDecoder()),
+	ring_(0),
+	captureThread_(0),
+	framesDropped_(0),
+	imagesReadAhead_(0),
+	videoReadAhead_(0),
+	videoTotalFrames_(0),
+	videoFrameIndex_(0),
+	lastStreamId_(-1)
 {
 	qRegisterMetaType<cv::Mat>("cv::Mat");
 	connect(&cameraTimer_, SIGNAL(timeout()), this, SLOT(takeImage()));
@@ -50,11 +105,28 @@ Camera::Camera(QObject * parent) :
 Camera::~Camera()
 {
 	this->stop();
+	delete decoder_;
 }
 
 void Camera::stop()
 {
 	stopTimer();
+	if(captureThread_)
+	{
+		captureThread_->stop();
+		delete captureThread_;
+		captureThread_ = 0;
+		UINFO("Camera: %d frames captured, %d dropped", ring_->pushed(), ring_->dropped()+ring_->skipped());
+		delete ring_;
+		ring_ = 0;
+	}
+	framesDropped_ = 0;
+	delete imagesReadAhead_;
+	imagesReadAhead_ = 0;
+	delete videoReadAhead_; // stop the thread before releasing the capture
+	videoReadAhead_ = 0;
+	videoTotalFrames_ = 0;
+	videoFrameIndex_ = 0;
 	capture_.release();
 	images_.clear();
 	currentImageIndex_ = 0;
@@ -64,6 +136,7 @@ void Camera::stop()
 		delete cameraTcpServer_;
 		cameraTcpServer_ = 0;
 	}
+	lastStreamId_ = -1;
 }
 
 void Camera::pause()
@@ -77,7 +150,11 @@ int Camera::getTotalFrames()
 	{
 		return images_.size();
 	}
-	else if(capture_.isOpened())
+	else if(videoReadAhead_)
+	{
+		return videoTotalFrames_;
+	}
+	else if(capture_.isOpened() && !captureThread_)
 	{
 		return (int)capture_.get(CV_CAP_PROP_FRAME_COUNT);
 	}
@@ -90,7 +167,11 @@ int Camera::getCurrentFrameIndex()
 	{
 		return currentImageIndex_;
 	}
-	else if(capture_.isOpened())
+	else if(videoReadAhead_)
+	{
+		return videoFrameIndex_;
+	}
+	else if(capture_.isOpened() && !captureThread_)
 	{
 		return (int)capture_.get(CV_CAP_PROP_POS_FRAMES);
 	}
@@ -103,7 +184,17 @@ void Camera::moveToFrame(int frame)
 	{
 		currentImageIndex_ = frame;
 	}
-	else if(capture_.isOpened() && frame < (int)capture_.get(CV_CAP_PROP_FRAME_COUNT))
+	else if(videoReadAhead_ && frame < videoTotalFrames_)
+	{
+		// restart decoding from the new position
+		int stride = videoReadAhead_->stride();
+		delete videoReadAhead_;
+		capture_.set(CV_CAP_PROP_POS_FRAMES, frame);
+		videoFrameIndex_ = frame;
+		videoReadAhead_ = new VideoReadAhead(&capture_, Settings::getCamera_readAhead(), stride);
+		videoReadAhead_->start();
+	}
+	else if(capture_.isOpened() && !captureThread_ && frame < (int)capture_.get(CV_CAP_PROP_FRAME_COUNT))
 	{
 		capture_.set(CV_CAP_PROP_POS_FRAMES, frame);
 	}
@@ -118,23 +209,70 @@ int Camera::getPort()
 	return 0;
 }
 
+int Camera::framesCaptured() const
+{
+	return ring_?ring_->pushed():0;
+}
+
+int Camera::framesDropped() const
+{
+	return ring_?ring_->dropped()+ring_->skipped():0;
+}
+
+int Camera::imagesBuffered() const
+{
+	if(cameraTcpServer_)
+	{
+		return cameraTcpServer_->imagesBuffered();
+	}
+	return 0;
+}
+
 void Camera::takeImage()
 {
 	cv::Mat img;
-	if(capture_.isOpened())
+	if(captureThread_)
+	{
+		// newest frame captured, nothing if no new frame since the last call
+		img = ring_->pop();
+		if(img.empty())
+		{
+			return;
+		}
+		int dropped = framesDropped();
+		if(dropped > framesDropped_)
+		{
+			UDEBUG("Camera: %d frames dropped (%d captured)", dropped, framesCaptured());
+			framesDropped_ = dropped;
+		}
+	}
+	else if(videoReadAhead_)
+	{
+		img = videoReadAhead_->take(); // already cloned
+		videoFrameIndex_ += videoReadAhead_->stride();
+	}
+	else if(capture_.isOpened())
 	{
 		capture_.read(img);// capture a frame
 	}
 	else if(!images_.empty())
 	{
-		if(currentImageIndex_ < (unsigned int)images_.size())
+		if(imagesReadAhead_ && currentImageIndex_ < (unsigned int)images_.size())
+		{
+			img = imagesReadAhead_->take(currentImageIndex_++);
+		}
+		else if(currentImageIndex_ < (unsigned int)images_.size())
 		{
-			img = cv::imread(images_[currentImageIndex_++]);
+			// decoded at the resolution requested if possible
+			img = decoder_->read(
+					images_[currentImageIndex_++],
+					Settings::getCamera_decodeGrayscale(),
+					cv::Size(Settings::getCamera_2imageWidth(), Settings::getCamera_3imageHeight()));
 		}
 	}
 	else if(cameraTcpServer_)
 	{
-		img = cameraTcpServer_->getImage();
+		img = cameraTcpServer_->getImage(&lastStreamId_);
 		if(cameraTcpServer_->imagesBuffered() > 0 && Settings::getCamera_9queueSize() == 0)
 		{
 			UWARN("%d images buffered so far...", cameraTcpServer_->imagesBuffered());
@@ -167,16 +305,16 @@ void Camera::takeImage()
 		{
 			cv::Mat resampled;
 			cv::resize(img, resampled, cv::Size(Settings::getCamera_2imageWidth(), Settings::getCamera_3imageHeight()));
-			Q_EMIT imageReceived(resampled);
+			img = resampled;
 		}
-		else if(capture_.isOpened())
+		else if(capture_.isOpened() && !captureThread_ && !videoReadAhead_)
 		{
-			Q_EMIT imageReceived(img.clone()); // clone required with VideoCapture::read()
-		}
-		else
-		{
-			Q_EMIT imageReceived(img); // clone not required with cv::imread()
+			img = img.clone(); // clone required with VideoCapture::read()
 		}
+		// clone not required with cv::imread()
+		Q_EMIT imagesPending(this->imagesBuffered());
+		Q_EMIT imageReceived(img);
+		Q_EMIT imageReceived(img, lastStreamId_);
 	}
 }
 
@@ -187,6 +325,7 @@ bool Camera::start()
 		if(Settings::getCamera_6useTcpCamera())
 		{
 			cameraTcpServer_ = new CameraTcpServer(Settings::getCamera_8port(), this);
+			connect(cameraTcpServer_, SIGNAL(streamStarted(int)), this, SIGNAL(streamStarted(int)));
 			if(!cameraTcpServer_->isListening())
 			{
 				UWARN("CameraTCP: Cannot listen to port %d", cameraTcpServer_->getPort());
@@ -219,6 +358,15 @@ bool Camera::start()
 					images_.append(path.toStdString() + UDirectory::separator() + *iter);
 				}
 				UINFO("Camera: Reading %d images from directory \"%s\"...", (int)images_.size(), path.toStdString().c_str());
+				if(images_.size() && Settings::getCamera_readAhead() > 0)
+				{
+					imagesReadAhead_ = new ImagesReadAhead(
+							images_,
+							Settings::getCamera_readAhead(),
+							Settings::getCamera_readAheadThreads(),
+							Settings::getCamera_decodeGrayscale(),
+							cv::Size(Settings::getCamera_2imageWidth(), Settings::getCamera_3imageHeight()));
+				}
 				if(images_.isEmpty())
 				{
 					UWARN("Camera: Directory \"%s\" is empty (no images matching the \"%s\" extensions). "
@@ -241,6 +389,13 @@ bool Camera::start()
 				else
 				{
 					UINFO("Camera: Reading from video file \"%s\"...", path.toStdString().c_str());
+					if(Settings::getCamera_readAhead() > 0)
+					{
+						videoTotalFrames_ = (int)capture_.get(CV_CAP_PROP_FRAME_COUNT);
+						videoFrameIndex_ = 0;
+						videoReadAhead_ = new VideoReadAhead(&capture_, Settings::getCamera_readAhead(), Settings::getCamera_videoStride());
+						videoReadAhead_->start();
+					}
 				}
 			}
 			if(!capture_.isOpened() && images_.empty())
@@ -253,6 +408,14 @@ bool Camera::start()
 					capture_.set(CV_CAP_PROP_FRAME_HEIGHT, double(Settings::getCamera_3imageHeight()));
 				}
 				UINFO("Camera: Reading from camera device %d...", Settings::getCamera_1deviceId());
+
+				if(capture_.isOpened() && Settings::getCamera_captureThread())
+				{
+					ring_ = new FrameRing(Settings::getCamera_captureRingSize());
+					captureThread_ = new CaptureThread(&capture_, ring_);
+					captureThread_->start();
+					UINFO("Camera: Capture thread started (ring of %d frames)", ring_->capacity());
+				}
 			}
 		}
 	}
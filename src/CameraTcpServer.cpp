@@ -36,7 +36,7 @@ namespace find_object {
 
 CameraTcpServer::CameraTcpServer(quint16 port, QObject *parent) :
 	QTcpServer(parent),
-    blockSize_(0)
+	lastStreamId_(-1)
 {
 	if (!this->listen(QHostAddress::Any, port))
 	{
@@ -45,31 +45,72 @@ CameraTcpServer::CameraTcpServer(quint16 port, QObject *parent) :
 	}
 }
 
-cv::Mat CameraTcpServer::getImage()
+cv::Mat CameraTcpServer::getImage(int * streamId)
 {
 	cv::Mat img;
-	if(images_.size())
+	int id = -1;
+	int queue = Settings::getCamera_9queueSize();
+	// round-robin: first stream with images buffered after the last one served
+	QMap<int, Stream>::iterator iter = streams_.upperBound(lastStreamId_);
+	int count = streams_.size();
+	for(int i=0; i<count && img.empty(); ++i)
 	{
+		if(iter == streams_.end())
+		{
+			iter = streams_.begin();
+		}
+		Stream & stream = iter.value();
 		// if queue changed after tcp connection ended with images still in the buffer
-		int queue = Settings::getCamera_9queueSize();
-		while(queue > 0 && images_.size() > queue)
+		while(queue > 0 && stream.images.size() > queue)
 		{
-			images_.pop_front();
+			stream.images.pop_front();
 		}
-
-		img = images_.front();
-		images_.pop_front();
+		if(stream.images.size())
+		{
+			img = stream.images.front();
+			stream.images.pop_front();
+			id = iter.key();
+			lastStreamId_ = id;
+		}
+		if(!stream.connected && stream.images.empty())
+		{
+			iter = streams_.erase(iter); // stream ID is free again
+		}
+		else
+		{
+			++iter;
+		}
+	}
+	if(streamId)
+	{
+		*streamId = id;
+	}
+	if(sockets_.size() == 1)
+	{
+		sockets_.begin().key()->waitForReadyRead(100);
 	}
-	if(this->findChildren<QTcpSocket*>().size() == 1)
+	else if(img.empty() && sockets_.size() > 1)
 	{
-		this->findChildren<QTcpSocket*>().first()->waitForReadyRead(100);
+		// all queues are empty: wait a little instead of being called again
+		// right away, without delaying the other streams too long
+		sockets_.begin().key()->waitForReadyRead(10);
 	}
 	return img;
 }
 
+int CameraTcpServer::imagesBuffered() const
+{
+	int images = 0;
+	for(QMap<int, Stream>::const_iterator iter=streams_.constBegin(); iter!=streams_.constEnd(); ++iter)
+	{
+		images += iter.value().images.size();
+	}
+	return images;
+}
+
 bool CameraTcpServer::isConnected() const
 {
-	return this->findChildren<QTcpSocket*>().size() > 0;
+	return sockets_.size() > 0;
 }
 
 QHostAddress CameraTcpServer::getHostAddress() const
@@ -103,55 +144,84 @@ quint16 CameraTcpServer::getPort() const
 
 void CameraTcpServer::incomingConnection(int socketDescriptor)
 {
-	QList<QTcpSocket*> clients = this->findChildren<QTcpSocket*>();
-	if(clients.size() >= 1)
+	int maxStreams = Settings::getCamera_maxStreams();
+	if(maxStreams > 0 && sockets_.size() >= maxStreams)
 	{
-		UWARN("A client is already connected. Only one connection allowed at the same time.");
+		UWARN("CameraTcp: %d clients already connected, connection refused (see \"Camera/maxStreams\").", sockets_.size());
 		QTcpSocket socket;
 		socket.setSocketDescriptor(socketDescriptor);
 		socket.close(); // close without sending an acknowledge
 	}
 	else
 	{
+		// lowest stream ID free
+		int id = 0;
+		while(streams_.contains(id))
+		{
+			++id;
+		}
+		streams_.insert(id, Stream());
+
 		QTcpSocket * socket = new QTcpSocket(this);
+		sockets_.insert(socket, id);
 		connect(socket, SIGNAL(readyRead()), this, SLOT(readReceivedData()));
 		connect(socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(displayError(QAbstractSocket::SocketError)));
 		connect(socket, SIGNAL(disconnected()), this, SLOT(connectionLost()));
 		socket->setSocketDescriptor(socketDescriptor);
 		socket->write(QByteArray("1")); // send acknowledge
+		UINFO("CameraTcp: Stream %d connected (%s:%d)",
+				id,
+				socket->peerAddress().toString().toStdString().c_str(),
+				(int)socket->peerPort());
+		Q_EMIT streamStarted(id);
 	}
 }
 
 void CameraTcpServer::readReceivedData()
 {
 	QTcpSocket * client = (QTcpSocket*)sender();
+	QMap<QTcpSocket*, int>::iterator socketIter = sockets_.find(client);
+	if(socketIter == sockets_.end() || !streams_.contains(socketIter.value()))
+	{
+		return;
+	}
+	Stream & stream = streams_[socketIter.value()];
+
 	QDataStream in(client);
 	in.setVersion(QDataStream::Qt_4_0);
 
-	if (blockSize_ == 0)
+	// all images received so far
+	while(true)
 	{
-		if (client->bytesAvailable() < (int)sizeof(quint64))
+		if (stream.blockSize == 0)
 		{
-			return;
-		}
+			if (client->bytesAvailable() < (int)sizeof(quint64))
+			{
+				return;
+			}
 
-		in >> blockSize_;
-	}
+			in >> stream.blockSize;
+		}
 
-	if (client->bytesAvailable() < (int)blockSize_)
-	{
-		return;
-	}
+		if (client->bytesAvailable() < (int)stream.blockSize)
+		{
+			return;
+		}
 
-	std::vector<unsigned char> buf(blockSize_);
-	in.readRawData((char*)buf.data(), blockSize_);
-	images_.push_back(cv::imdecode(buf, cv::IMREAD_UNCHANGED));
-	int queue = Settings::getCamera_9queueSize();
-	while(queue > 0 && images_.size() > queue)
-	{
-		images_.pop_front();
+		std::vector<unsigned char> buf(stream.blockSize);
+		in.readRawData((char*)buf.data(), stream.blockSize);
+		// decoded at the resolution requested if possible
+		stream.images.push_back(stream.decoder.decode(
+				buf,
+				Settings::getCamera_decodeGrayscale(),
+				cv::Size(Settings::getCamera_2imageWidth(), Settings::getCamera_3imageHeight())));
+		int queue = Settings::getCamera_9queueSize();
+		while(queue > 0 && stream.images.size() > queue)
+		{
+			stream.images.pop_front();
+		}
+		stream.blockSize = 0;
 	}
-	blockSize_ = 0;
 }
 
 void CameraTcpServer::displayError(QAbstractSocket::SocketError socketError)
@@ -179,9 +249,29 @@ void CameraTcpServer::displayError(QAbstractSocket::SocketError socketError)
 void CameraTcpServer::connectionLost()
 {
 	//printf("[WARNING] CameraTcp: Connection lost!\n");
-	((QTcpSocket*)sender())->close();
-	sender()->deleteLater();
-	blockSize_ = 0; // reset
+	QTcpSocket * client = (QTcpSocket*)sender();
+	client->close();
+	client->deleteLater();
+	QMap<QTcpSocket*, int>::iterator iter = sockets_.find(client);
+	if(iter != sockets_.end())
+	{
+		int id = iter.value();
+		sockets_.erase(iter);
+		UINFO("CameraTcp: Stream %d disconnected", id);
+		if(streams_.contains(id))
+		{
+			if(streams_[id].images.empty())
+			{
+				streams_.remove(id);
+			}
+			else
+			{
+				// keep the images buffered, the stream is removed when they are all taken
+				streams_[id].connected = false;
+				streams_[id].blockSize = 0;
+			}
+		}
+	}
 }
 
 } // namespace find_object
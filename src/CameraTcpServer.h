@@ -29,18 +29,27 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define CAMERATCPCLIENT_H_
 
 #include <QtNetwork/QTcpServer>
+#include <QtCore/QMap>
+#include <QtCore/QList>
 #include <opencv2/opencv.hpp>
+#include "ImageDecoder.h"
+
+class QTcpSocket;
 
 namespace find_object {
 
+// Each client connected is a stream with its own framing state and
+// queue of images (Camera/9queueSize). Streams are identified by
+// the lowest ID free when they connect, their images are taken in turn.
 class CameraTcpServer : public QTcpServer
 {
 	Q_OBJECT;
 public:
 	CameraTcpServer(quint16 port = 0, QObject * parent = 0);
-	cv::Mat getImage();
-	int imagesBuffered() const {return images_.size();}
+	cv::Mat getImage(int * streamId = 0); // round-robin between streams
+	int imagesBuffered() const;
 	bool isConnected() const;
+	int streams() const {return sockets_.size();} // clients connected
 
 	QHostAddress getHostAddress() const;
 	quint16 getPort() const;
@@ -48,14 +57,28 @@ public:
 protected:
 	virtual void incomingConnection ( int socketDescriptor );
 
+Q_SIGNALS:
+	void streamStarted(int streamId); // a new client got this stream ID, previous states of the ID are obsolete
+
 private Q_SLOTS:
 	void readReceivedData();
 	void displayError(QAbstractSocket::SocketError socketError);
 	void connectionLost();
 
 private:
-	quint64 blockSize_;
-	QVector<cv::Mat> images_;
+	class Stream
+	{
+	public:
+		Stream() : blockSize(0), connected(true) {}
+		quint64 blockSize;
+		QList<cv::Mat> images;
+		ImageDecoder decoder;
+		bool connected; // images can still be buffered after the connection is lost
+	};
+
+	QMap<int, Stream> streams_; // <stream ID, stream>
+	QMap<QTcpSocket*, int> sockets_; // <client, stream ID>
+	int lastStreamId_; // last stream an image was taken from
 };
 
 } // namespace find_object
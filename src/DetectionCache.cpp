@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/DetectionCache.h"
+#include "find_object/utilite/ULogger.h"
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QMutexLocker>
+
+namespace find_object {
+
+DetectionCache::DetectionCache(int capacity) :
+	capacity_(capacity),
+	version_(0),
+	hits_(0),
+	misses_(0)
+{
+	UASSERT(capacity_ > 0);
+}
+
+QByteArray DetectionCache::hash(const char * data, int size)
+{
+	return QCryptographicHash::hash(QByteArray::fromRawData(data, size), QCryptographicHash::Md5);
+}
+
+int DetectionCache::version() const
+{
+	QMutexLocker lock(&mutex_);
+	return version_;
+}
+
+void DetectionCache::invalidate()
+{
+	QMutexLocker lock(&mutex_);
+	++version_;
+	entries_.clear();
+	order_.clear();
+	UDEBUG("version=%d", version_);
+}
+
+bool DetectionCache::get(const QByteArray & hash, DetectionInfo & info)
+{
+	QMutexLocker lock(&mutex_);
+	QHash<QByteArray, DetectionInfo>::const_iterator iter = entries_.constFind(hash);
+	if(iter == entries_.constEnd())
+	{
+		++misses_;
+		return false;
+	}
+	++hits_;
+	info = iter.value();
+	order_.removeOne(hash);
+	order_.prepend(hash);
+	return true;
+}
+
+void DetectionCache::insert(const QByteArray & hash, int version, const DetectionInfo & info)
+{
+	QMutexLocker lock(&mutex_);
+	if(version != version_)
+	{
+		UDEBUG("Catalog changed (version %d vs %d), detection not cached", version, version_);
+		return;
+	}
+	if(entries_.contains(hash))
+	{
+		order_.removeOne(hash);
+	}
+	entries_.insert(hash, info);
+	order_.prepend(hash);
+	while(order_.size() > capacity_)
+	{
+		entries_.remove(order_.takeLast());
+	}
+}
+
+int DetectionCache::hits() const
+{
+	QMutexLocker lock(&mutex_);
+	return hits_;
+}
+
+int DetectionCache::misses() const
+{
+	QMutexLocker lock(&mutex_);
+	return misses_;
+}
+
+float DetectionCache::hitRate() const
+{
+	QMutexLocker lock(&mutex_);
+	return hits_+misses_>0?float(hits_)/float(hits_+misses_):0.0f;
+}
+
+} // namespace find_object
@@ -33,26 +33,45 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ObjSignature.h"
 #include "utilite/UDirectory.h"
 #include "Vocabulary.h"
+#include "Vlad.h"
+#include "SearchPlanner.h"
+#include "Prosac.h"
+#include "LatencyController.h"
+#include "IncrementalFeatures.h"
+#include "FrameGate.h"
+#include "StreamStates.h"
 
 #include <QtCore/QThread>
 #include <QtCore/QFileInfo>
 #include <QtCore/QStringList>
+#include <QtCore/QSet>
 #include <QtCore/QTime>
 #include <QtCore/QDir>
 #include <QGraphicsRectItem>
 #include <stdio.h>
+#include <list>
+#include <map>
+#include <algorithm>
+#include <functional>
 
 namespace find_object {
 
 FindObject::FindObject(bool keepImagesInRAM, QObject * parent) :
 	QObject(parent),
 	vocabulary_(new Vocabulary()),
+	vlad_(new Vlad()),
+	planner_(new SearchPlanner()),
+	latencyController_(new LatencyController()),
+	streams_(new StreamStates()),
 	detector_(Settings::createKeypointDetector()),
 	extractor_(Settings::createDescriptorExtractor()),
 	sessionModified_(false),
-	keepImagesInRAM_(keepImagesInRAM)
+	keepImagesInRAM_(keepImagesInRAM),
+	requiredFields_(DetectionInfo::kFieldNone),
+	lastSceneSize_(0,0)
 {
 	qRegisterMetaType<find_object::DetectionInfo>("find_object::DetectionInfo");
+	qRegisterMetaType<find_object::DetectionInfoPtr>("find_object::DetectionInfoPtr");
 	UASSERT(detector_ != 0 && extractor_ != 0);
 
 	if(Settings::getGeneral_debug())
@@ -71,6 +90,10 @@ FindObject::~FindObject() {
 	delete detector_;
 	delete extractor_;
 	delete vocabulary_;
+	delete vlad_;
+	delete planner_;
+	delete latencyController_;
+	delete streams_;
 	objectsDescriptors_.clear();
 }
 
@@ -126,6 +149,11 @@ bool FindObject::loadSession(const QString & path, const ParametersMap & customP
 			// this will fill objectsDescriptors_ matrix
 			updateVocabulary();
 		}
+		else
+		{
+			updateInvertedIndex();
+			updateGlobalDescriptors(true);
+		}
 		sessionModified_ = false;
 		return true;
 	}
@@ -399,6 +427,9 @@ void FindObject::removeObjectAndUpdate(int id)
 
 void FindObject::updateDetectorExtractor()
 {
+	latencyController_->reset();
+	streams_->resetIncrementalFeatures();
+	streams_->resetFrameGates();
 	delete detector_;
 	delete extractor_;
 	detector_ = Settings::createKeypointDetector();
@@ -406,25 +437,179 @@ void FindObject::updateDetectorExtractor()
 	UASSERT(detector_ != 0 && extractor_ != 0);
 }
 
-std::vector<cv::KeyPoint> limitKeypoints(const std::vector<cv::KeyPoint> & keypoints, int maxKeypoints)
+struct KeypointResponseGreater
 {
-	std::vector<cv::KeyPoint> kptsKept;
+	KeypointResponseGreater(const std::vector<cv::KeyPoint> & keypoints) : keypoints_(&keypoints) {}
+	bool operator()(int a, int b) const
+	{
+		return fabs(keypoints_->at(a).response) > fabs(keypoints_->at(b).response);
+	}
+	const std::vector<cv::KeyPoint> * keypoints_;
+};
+
+// Keep the maxKeypoints strongest of indexes (linear time selection)
+void selectStrongest(const std::vector<cv::KeyPoint> & keypoints, std::vector<int> & indexes, int maxKeypoints)
+{
+	if((int)indexes.size() > maxKeypoints)
+	{
+		std::nth_element(indexes.begin(), indexes.begin()+maxKeypoints, indexes.end(), KeypointResponseGreater(keypoints));
+		indexes.resize(maxKeypoints);
+	}
+}
+
+// Grid bucketing: each cell keeps its strongest keypoints up to an equal
+// quota, the budget left by cells with less keypoints goes to the strongest
+// keypoints remaining.
+std::vector<int> selectKeypointsGrid(const std::vector<cv::KeyPoint> & keypoints, int maxKeypoints, int gridSize)
+{
+	gridSize = std::max(gridSize, 1);
+	float maxX = 0.0f;
+	float maxY = 0.0f;
+	for(unsigned int i=0; i<keypoints.size(); ++i)
+	{
+		maxX = std::max(maxX, keypoints[i].pt.x);
+		maxY = std::max(maxY, keypoints[i].pt.y);
+	}
+	float cellWidth = (maxX+1.0f)/float(gridSize);
+	float cellHeight = (maxY+1.0f)/float(gridSize);
+	std::vector<std::vector<int> > cells(gridSize*gridSize);
+	for(unsigned int i=0; i<keypoints.size(); ++i)
+	{
+		int x = std::min(std::max(int(keypoints[i].pt.x/cellWidth), 0), gridSize-1);
+		int y = std::min(std::max(int(keypoints[i].pt.y/cellHeight), 0), gridSize-1);
+		cells[y*gridSize+x].push_back(i);
+	}
+
+	int quota = maxKeypoints / int(cells.size());
+	std::vector<int> kept;
+	std::vector<int> remaining;
+	kept.reserve(maxKeypoints);
+	for(unsigned int i=0; i<cells.size(); ++i)
+	{
+		std::vector<int> & cell = cells[i];
+		if((int)cell.size() > quota)
+		{
+			std::nth_element(cell.begin(), cell.begin()+quota, cell.end(), KeypointResponseGreater(keypoints));
+			remaining.insert(remaining.end(), cell.begin()+quota, cell.end());
+			cell.resize(quota);
+		}
+		kept.insert(kept.end(), cell.begin(), cell.end());
+	}
+	selectStrongest(keypoints, remaining, maxKeypoints - (int)kept.size());
+	kept.insert(kept.end(), remaining.begin(), remaining.end());
+	return kept;
+}
+
+// Adaptive non-maximal suppression: keypoints are suppressed in the
+// neighborhood of stronger ones, the radius is found by binary search so that
+// at least maxKeypoints are kept (approximated with a coverage grid of r/2
+// cells, see Bailo et al., "Efficient adaptive non-maximal suppression
+// algorithms for homogeneous spatial keypoint distribution", 2018).
+std::vector<int> selectKeypointsANMS(const std::vector<cv::KeyPoint> & keypoints, int maxKeypoints)
+{
+	std::vector<int> sorted(keypoints.size());
+	float maxX = 0.0f;
+	float maxY = 0.0f;
+	for(unsigned int i=0; i<keypoints.size(); ++i)
+	{
+		sorted[i] = i;
+		maxX = std::max(maxX, keypoints[i].pt.x);
+		maxY = std::max(maxY, keypoints[i].pt.y);
+	}
+	std::sort(sorted.begin(), sorted.end(), KeypointResponseGreater(keypoints));
+
+	std::vector<int> best(sorted.begin(), sorted.begin()+maxKeypoints); // radius 0
+	int low = 1;
+	int high = int(std::max(maxX, maxY)) + 1;
+	std::vector<int> selected;
+	std::vector<unsigned char> covered;
+	while(low <= high)
+	{
+		int radius = (low + high) / 2;
+		float cellSize = std::max(float(radius)/2.0f, 1.0f);
+		int cellsRadius = int(std::ceil(float(radius)/cellSize));
+		int cols = int(maxX/cellSize) + 1;
+		int rows = int(maxY/cellSize) + 1;
+		covered.assign(cols*rows, 0);
+		selected.clear();
+		for(unsigned int i=0; i<sorted.size() && (int)selected.size() < maxKeypoints; ++i)
+		{
+			const cv::Point2f & pt = keypoints[sorted[i]].pt;
+			int x = std::min(std::max(int(pt.x/cellSize), 0), cols-1);
+			int y = std::min(std::max(int(pt.y/cellSize), 0), rows-1);
+			if(!covered[y*cols+x])
+			{
+				selected.push_back(sorted[i]);
+				for(int v=std::max(y-cellsRadius, 0); v<=std::min(y+cellsRadius, rows-1); ++v)
+				{
+					for(int u=std::max(x-cellsRadius, 0); u<=std::min(x+cellsRadius, cols-1); ++u)
+					{
+						covered[v*cols+u] = 1;
+					}
+				}
+			}
+		}
+		if((int)selected.size() >= maxKeypoints)
+		{
+			// enough keypoints, try a larger radius
+			best = selected;
+			low = radius + 1;
+		}
+		else
+		{
+			high = radius - 1;
+		}
+	}
+	return best;
+}
+
+// Indexes of the keypoints kept (see "Feature2D/3MaxFeaturesSelection"), in their original order
+std::vector<int> selectKeypoints(const std::vector<cv::KeyPoint> & keypoints, int maxKeypoints)
+{
+	std::vector<int> indexes;
 	if(maxKeypoints > 0 && (int)keypoints.size() > maxKeypoints)
 	{
-		// Sort words by response
-		std::multimap<float, int> reponseMap; // <response,id>
-		for(unsigned int i = 0; i <keypoints.size(); ++i)
+		int strategy = Settings::getFeature2D_3MaxFeaturesSelection().split(':').first().toInt();
+		if(strategy == 1)
+		{
+			indexes = selectKeypointsGrid(keypoints, maxKeypoints, Settings::getFeature2D_3MaxFeaturesGridSize());
+		}
+		else if(strategy == 2)
+		{
+			indexes = selectKeypointsANMS(keypoints, maxKeypoints);
+		}
+		else
+		{
+			indexes.resize(keypoints.size());
+			for(unsigned int i=0; i<indexes.size(); ++i)
+			{
+				indexes[i] = i;
+			}
+			selectStrongest(keypoints, indexes, maxKeypoints);
+		}
+		std::sort(indexes.begin(), indexes.end());
+	}
+	else
+	{
+		indexes.resize(keypoints.size());
+		for(unsigned int i=0; i<indexes.size(); ++i)
 		{
-			//Keep track of the data, to be easier to manage the data in the next step
-			reponseMap.insert(std::pair<float, int>(fabs(keypoints[i].response), i));
+			indexes[i] = i;
 		}
+	}
+	return indexes;
+}
 
-		// Remove them
-		std::multimap<float, int>::reverse_iterator iter = reponseMap.rbegin();
-		kptsKept.resize(maxKeypoints);
-		for(unsigned int k=0; k < kptsKept.size() && iter!=reponseMap.rend(); ++k, ++iter)
+std::vector<cv::KeyPoint> limitKeypoints(const std::vector<cv::KeyPoint> & keypoints, int maxKeypoints)
+{
+	std::vector<cv::KeyPoint> kptsKept;
+	if(maxKeypoints > 0 && (int)keypoints.size() > maxKeypoints)
+	{
+		std::vector<int> indexes = selectKeypoints(keypoints, maxKeypoints);
+		kptsKept.resize(indexes.size());
+		for(unsigned int k=0; k < indexes.size(); ++k)
 		{
-			kptsKept[k] = keypoints[iter->second];
+			kptsKept[k] = keypoints[indexes[k]];
 		}
 	}
 	else
@@ -437,32 +622,19 @@ std::vector<cv::KeyPoint> limitKeypoints(const std::vector<cv::KeyPoint> & keypo
 void limitKeypoints(std::vector<cv::KeyPoint> & keypoints, cv::Mat & descriptors, int maxKeypoints)
 {
 	UASSERT((int)keypoints.size() == descriptors.rows);
-	std::vector<cv::KeyPoint> kptsKept;
-	cv::Mat descriptorsKept;
 	if(maxKeypoints > 0 && (int)keypoints.size() > maxKeypoints)
 	{
-		descriptorsKept = cv::Mat(0, descriptors.cols, descriptors.type());
-
-		// Sort words by response
-		std::multimap<float, int> reponseMap; // <response,id>
-		for(unsigned int i = 0; i <keypoints.size(); ++i)
-		{
-			//Keep track of the data, to be easier to manage the data in the next step
-			reponseMap.insert(std::pair<float, int>(fabs(keypoints[i].response), i));
-		}
-
-		// Remove them
-		std::multimap<float, int>::reverse_iterator iter = reponseMap.rbegin();
-		kptsKept.resize(maxKeypoints);
-		descriptorsKept.reserve(maxKeypoints);
-		for(unsigned int k=0; k < kptsKept.size() && iter!=reponseMap.rend(); ++k, ++iter)
+		std::vector<int> indexes = selectKeypoints(keypoints, maxKeypoints);
+		std::vector<cv::KeyPoint> kptsKept(indexes.size());
+		cv::Mat descriptorsKept((int)indexes.size(), descriptors.cols, descriptors.type());
+		for(unsigned int k=0; k < indexes.size(); ++k)
 		{
-			kptsKept[k] = keypoints[iter->second];
-			descriptorsKept.push_back(descriptors.row(iter->second));
+			kptsKept[k] = keypoints[indexes[k]];
+			descriptors.row(indexes[k]).copyTo(descriptorsKept.row(k));
 		}
+		keypoints = kptsKept;
+		descriptors = descriptorsKept;
 	}
-	keypoints = kptsKept;
-	descriptors = descriptorsKept;
 	UASSERT_MSG((int)keypoints.size() == descriptors.rows, uFormat("%d vs %d", (int)keypoints.size(), descriptors.rows).c_str());
 }
 
@@ -474,14 +646,18 @@ void computeFeatures(
 		std::vector<cv::KeyPoint> & keypoints,
 		cv::Mat & descriptors,
 		int & timeDetection,
-		int & timeExtraction)
+		int & timeExtraction,
+		int maxFeatures = -1) // -1 means Feature2D/3MaxFeatures
 {
 	QTime timeStep;
 	timeStep.start();
 	keypoints.clear();
 	descriptors = cv::Mat();
 
-	int maxFeatures = Settings::getFeature2D_3MaxFeatures();
+	if(maxFeatures < 0)
+	{
+		maxFeatures = Settings::getFeature2D_3MaxFeatures();
+	}
 	if(Settings::currentDetectorType() == Settings::currentDescriptorType())
 	{
 		detector->detectAndCompute(image, keypoints, descriptors, mask);
@@ -612,12 +788,14 @@ public:
 			Feature2D * extractor,
 			const cv::Mat & image,
 			float tilt,
-			float phi) :
+			float phi,
+			int maxFeatures = -1) :
 		detector_(detector),
 		extractor_(extractor),
 		image_(image),
 		tilt_(tilt),
 		phi_(phi),
+		maxFeatures_(maxFeatures),
 		timeSkewAffine_(0),
 		timeDetection_(0),
 		timeExtraction_(0),
@@ -652,7 +830,8 @@ protected:
 				keypoints_,
 				descriptors_,
 				timeDetection_,
-				timeExtraction_);
+				timeExtraction_,
+				maxFeatures_);
 		timeStep.start();
 
 		// Transform points to original image coordinates
@@ -688,6 +867,7 @@ private:
 	cv::Mat image_;
 	float tilt_;
 	float phi_;
+	int maxFeatures_;
 	std::vector<cv::KeyPoint> keypoints_;
 	cv::Mat descriptors_;
 
@@ -704,11 +884,17 @@ public:
 			Feature2D * detector,
 			Feature2D * extractor,
 			int objectId,
-			const cv::Mat & image) :
+			const cv::Mat & image,
+			int maxFeatures = -1,  // -1 means Feature2D/3MaxFeatures
+			int affineCount = -1, // -1 means Feature2D/5AffineCount
+			const cv::Mat & mask = cv::Mat()) : // not used with Feature2D/4Affine
 		detector_(detector),
 		extractor_(extractor),
 		objectId_(objectId),
 		image_(image),
+		mask_(mask),
+		maxFeatures_(maxFeatures),
+		affineCount_(affineCount),
 		timeSkewAffine_(0),
 		timeDetection_(0),
 		timeExtraction_(0),
@@ -746,11 +932,12 @@ protected:
 					detector_,
 					extractor_,
 					image_,
-					cv::Mat(),
+					mask_,
 					keypoints_,
 					descriptors_,
 					timeDetection_,
-					timeExtraction_);
+					timeExtraction_,
+					maxFeatures_);
 			timeStep.start();
 
 			if(keypoints_.size())
@@ -786,7 +973,7 @@ protected:
 			std::vector<float> phis;
 			tilts.push_back(1.0f);
 			phis.push_back(0.0f);
-			int nTilt = Settings::getFeature2D_5AffineCount();
+			int nTilt = affineCount_>=0?affineCount_:Settings::getFeature2D_5AffineCount();
 			for(int t=1; t<nTilt; ++t)
 			{
 				float tilt = std::pow(2.0f, 0.5f*float(t));
@@ -811,7 +998,7 @@ protected:
 
 				for(unsigned int k=i; k<i+threadCounts && k<tilts.size(); ++k)
 				{
-					threads.push_back(new AffineExtractionThread(detector_, extractor_, image_, tilts[k], phis[k]));
+					threads.push_back(new AffineExtractionThread(detector_, extractor_, image_, tilts[k], phis[k], maxFeatures_));
 					threads.back()->start();
 				}
 
@@ -839,6 +1026,9 @@ private:
 	Feature2D * extractor_;
 	int objectId_;
 	cv::Mat image_;
+	cv::Mat mask_;
+	int maxFeatures_;
+	int affineCount_;
 	std::vector<cv::KeyPoint> keypoints_;
 	cv::Mat descriptors_;
 
@@ -923,6 +1113,14 @@ void FindObject::updateObjects(const QList<int> & ids)
 					{
 						objects_.value(id)->removeImage();
 					}
+					else if(Settings::getHomography_opticalFlow() && lastSceneSize_.area())
+					{
+						// precompute for the next frames
+						objects_.value(id)->opticalFlowPyramid(
+								lastSceneSize_,
+								Settings::getHomography_opticalFlowWinSize(),
+								Settings::getHomography_opticalFlowMaxLevel());
+					}
 					delete threads[j];
 				}
 			}
@@ -939,11 +1137,69 @@ void FindObject::clearVocabulary()
 {
 	objectsDescriptors_.clear();
 	dataRange_.clear();
+	vocabulary_->setBruteForce(false);
 	vocabulary_->clear();
+	globalDescriptors_ = cv::Mat();
+	globalDescriptorsIds_.clear();
+}
+
+void FindObject::updateInvertedIndex()
+{
+	QMap<int, QMultiMap<int, int> > objectsWords;
+	for(QMap<int, ObjSignature*>::const_iterator iter=objects_.constBegin(); iter!=objects_.constEnd(); ++iter)
+	{
+		if(iter.value()->words().size())
+		{
+			objectsWords.insert(iter.key(), iter.value()->words());
+		}
+	}
+	vocabulary_->updateInvertedIndex(objectsWords, Settings::getGeneral_stopWordsMaxFrequency());
+}
+
+void FindObject::updateGlobalDescriptors(bool retrain)
+{
+	globalDescriptors_ = cv::Mat();
+	globalDescriptorsIds_.clear();
+	if(!Settings::getGeneral_invertedSearch() || !Settings::getGeneral_globalRetrieval())
+	{
+		vlad_->clear();
+		return;
+	}
+
+	QTime time;
+	time.start();
+	if(retrain || !vlad_->isTrained())
+	{
+		UINFO("Training global descriptors codebook with %d objects...", objects_.size());
+		std::vector<cv::Mat> descriptors;
+		descriptors.reserve(objects_.size());
+		for(QMap<int, ObjSignature*>::const_iterator iter=objects_.constBegin(); iter!=objects_.constEnd(); ++iter)
+		{
+			descriptors.push_back(iter.value()->descriptors());
+		}
+		if(!vlad_->train(descriptors, Settings::getGeneral_globalRetrievalClusters(), Settings::getGeneral_globalRetrievalDim()))
+		{
+			UWARN("Global descriptors codebook cannot be trained, global retrieval is disabled.");
+			return;
+		}
+	}
+
+	globalDescriptorsIds_.reserve(objects_.size());
+	for(QMap<int, ObjSignature*>::const_iterator iter=objects_.constBegin(); iter!=objects_.constEnd(); ++iter)
+	{
+		cv::Mat vlad = vlad_->compute(iter.value()->descriptors());
+		if(!vlad.empty())
+		{
+			globalDescriptors_.push_back(vlad);
+			globalDescriptorsIds_.push_back(iter.key());
+		}
+	}
+	UINFO("Global descriptors of %d objects computed (dim=%d, %d ms)", globalDescriptors_.rows, vlad_->dim(), time.elapsed());
 }
 
 void FindObject::updateVocabulary(const QList<int> & ids)
 {
+	streams_->resetFrameGates(); // objects changed
 	int count = 0;
 	int dim = -1;
 	int type = -1;
@@ -1110,6 +1366,9 @@ void FindObject::updateVocabulary(const QList<int> & ids)
 				vocabulary_->update();
 			}
 
+			updateInvertedIndex();
+			updateGlobalDescriptors(ids.isEmpty());
+
 			if(incremental)
 			{
 				UINFO("Creating incremental vocabulary... done! size=%d (%d ms)", vocabulary_->size(), time.elapsed());
@@ -1123,17 +1382,45 @@ void FindObject::updateVocabulary(const QList<int> & ids)
 				UINFO("Creating vocabulary... done! size=%d (%d ms)", vocabulary_->size(), time.elapsed());
 			}
 		}
+
+		if(Settings::getGeneral_autoPlan())
+		{
+			int objectsDescriptors = 0;
+			for(QMap<int, ObjSignature*>::const_iterator iter=objects_.constBegin(); iter!=objects_.constEnd(); ++iter)
+			{
+				objectsDescriptors += iter.value()->descriptors().rows;
+			}
+			int vocabularySize = Settings::getGeneral_invertedSearch()?vocabulary_->size():objectsDescriptors;
+			float invertedCost = 0.0f;
+			float directCost = 0.0f;
+			bool inverted = planner_->isInvertedSearchRecommended(vocabularySize, objectsDescriptors, invertedCost, directCost);
+			UINFO("Search plan: %d objects, %d descriptors (%s, %d bytes), ~%d scene descriptors: inverted search cost=%.0f, "
+					"direct search cost=%.0f, %s search is recommended (\"%s\"=%s, \"%s\"=%s)",
+					objects_.size(),
+					objectsDescriptors,
+					type == CV_8U?"binary":"float",
+					dim * (type == CV_8U?1:4),
+					planner_->sceneDescriptors(),
+					invertedCost,
+					directCost,
+					inverted?"inverted":"direct",
+					Settings::kGeneral_invertedSearch().toStdString().c_str(),
+					Settings::getGeneral_invertedSearch()?"true":"false",
+					Settings::kNearestNeighbor_1Strategy().toStdString().c_str(),
+					Settings::currentNearestNeighborType().toStdString().c_str());
+		}
 	}
 }
 
 class SearchThread: public QThread
 {
 public:
-	SearchThread(Vocabulary * vocabulary, int objectId, const cv::Mat * descriptors, const QMultiMap<int, int> * sceneWords) :
+	SearchThread(Vocabulary * vocabulary, int objectId, const cv::Mat * descriptors, const QMultiMap<int, int> * sceneWords, int searchChecks = 0) :
 		vocabulary_(vocabulary),
 		objectId_(objectId),
 		descriptors_(descriptors),
 		sceneWords_(sceneWords),
+		searchChecks_(searchChecks),
 		minMatchedDistance_(-1.0f),
 		maxMatchedDistance_(-1.0f)
 	{
@@ -1144,7 +1431,7 @@ public:
 	int getObjectId() const {return objectId_;}
 	float getMinMatchedDistance() const {return minMatchedDistance_;}
 	float getMaxMatchedDistance() const {return maxMatchedDistance_;}
-	const QMultiMap<int, int> & getMatches() const {return matches_;}
+	const DetectionInfo::Matches & getMatches() const {return matches_;}
 
 protected:
 	virtual void run()
@@ -1159,7 +1446,7 @@ protected:
 		int k = Settings::getNearestNeighbor_3nndrRatioUsed()?2:1;
 		results = cv::Mat(descriptors_->rows, k, CV_32SC1); // results index
 		dists = cv::Mat(descriptors_->rows, k, CV_32FC1); // Distance results are CV_32FC1
-		vocabulary_->search(*descriptors_, results, dists, k);
+		vocabulary_->search(*descriptors_, results, dists, k, searchChecks_);
 
 		// PROCESS RESULTS
 		// Get all matches for each object
@@ -1169,6 +1456,7 @@ protected:
 			bool matched = false;
 
 			if(Settings::getNearestNeighbor_3nndrRatioUsed() &&
+			   results.at<int>(i,1) >= 0 && // second neighbor found
 			   dists.at<float>(i,0) <= Settings::getNearestNeighbor_4nndrRatio() * dists.at<float>(i,1))
 			{
 				matched = true;
@@ -1201,8 +1489,7 @@ protected:
 			int wordId = results.at<int>(i,0);
 			if(matched && sceneWords_->count(wordId) == 1)
 			{
-				matches_.insert(i, sceneWords_->value(wordId));
-				matches_.insert(i, results.at<int>(i,0));
+				matches_.push_back(DetectionInfo::Match(i, sceneWords_->value(wordId), dists.at<float>(i,0)));
 			}
 		}
 
@@ -1213,42 +1500,249 @@ private:
 	int objectId_;
 	const cv::Mat * descriptors_;
 	const QMultiMap<int, int> * sceneWords_; // <word id, keypoint indexes>
+	int searchChecks_;
 
 	float minMatchedDistance_;
 	float maxMatchedDistance_;
-	QMultiMap<int, int> matches_;
+	DetectionInfo::Matches matches_;
 };
 
+// Pose clustering (Lowe's generalized Hough transform): each match votes
+// for the object's pose (center location, log scale, orientation) in the two
+// closest bins of each dimension. Matches are then assigned to the largest
+// bins first, so returned clusters are disjoint, the largest first.
+bool houghBinGreater(const std::pair<int, const std::vector<int> *> & a, const std::pair<int, const std::vector<int> *> & b)
+{
+	return a.first > b.first;
+}
+
+void houghClusters(
+		const DetectionInfo::Matches & matches,
+		const std::vector<cv::KeyPoint> & kptsA,
+		const std::vector<cv::KeyPoint> & kptsB,
+		const QRect & objectRect,
+		int minClusterSize,
+		std::list<DetectionInfo::Matches> & clusters)
+{
+	float locationBin = Settings::getHomography_houghLocationBin();
+	int orientationBin = Settings::getHomography_houghOrientationBin();
+	float scaleBin = Settings::getHomography_houghScaleBin();
+	if(locationBin <= 0.0f)
+	{
+		locationBin = 0.25f;
+	}
+	if(orientationBin <= 0 || orientationBin > 360)
+	{
+		orientationBin = 360;
+	}
+	if(scaleBin <= 1.0f)
+	{
+		scaleBin = 2.0f;
+	}
+	int orientationBins = 360 / orientationBin;
+	float objectSize = (float)std::max(objectRect.width(), objectRect.height());
+	float cx = objectRect.x() + objectRect.width()/2.0f;
+	float cy = objectRect.y() + objectRect.height()/2.0f;
+	float logScaleBin = std::log(scaleBin);
+
+	// <bin key, match indexes>
+	std::map<quint64, std::vector<int> > bins;
+	for(unsigned int i=0; i<matches.size(); ++i)
+	{
+		const cv::KeyPoint & a = kptsA.at(matches[i].objectIndex);
+		const cv::KeyPoint & b = kptsB.at(matches[i].sceneIndex);
+		bool useScale = a.size > 0.0f && b.size > 0.0f;
+		bool useAngle = a.angle >= 0.0f && b.angle >= 0.0f;
+		float scale = useScale?b.size/a.size:1.0f;
+		float angle = useAngle?b.angle-a.angle:0.0f;
+		while(angle < 0.0f)
+		{
+			angle += 360.0f;
+		}
+		while(angle >= 360.0f)
+		{
+			angle -= 360.0f;
+		}
+
+		// predicted object's center in the scene
+		float rad = angle*float(CV_PI)/180.0f;
+		float dx = cx - a.pt.x;
+		float dy = cy - a.pt.y;
+		float px = b.pt.x + scale*(std::cos(rad)*dx - std::sin(rad)*dy);
+		float py = b.pt.y + scale*(std::sin(rad)*dx + std::cos(rad)*dy);
+
+		// two closest bins on each dimension
+		float sv = useScale?std::log(scale)/logScaleBin:0.0f;
+		int s[2] = {cvRound(sv), cvRound(sv) + (sv < cvRound(sv)?-1:1)};
+		float ov = angle/orientationBin;
+		int o[2] = {int(ov)%orientationBins, 0};
+		o[1] = (ov - int(ov) < 0.5f?o[0]-1+orientationBins:o[0]+1)%orientationBins;
+		int sCount = useScale?2:1;
+		int oCount = useAngle&&orientationBins>1?2:1;
+		for(int si=0; si<sCount; ++si)
+		{
+			float binSize = locationBin * objectSize * std::pow(scaleBin, float(s[si]));
+			if(binSize < 1.0f)
+			{
+				binSize = 1.0f;
+			}
+			float xv = px/binSize;
+			float yv = py/binSize;
+			int x[2] = {cvFloor(xv), cvFloor(xv) + (xv-cvFloor(xv) < 0.5f?-1:1)};
+			int y[2] = {cvFloor(yv), cvFloor(yv) + (yv-cvFloor(yv) < 0.5f?-1:1)};
+			for(int oi=0; oi<oCount; ++oi)
+			{
+				for(int xi=0; xi<2; ++xi)
+				{
+					for(int yi=0; yi<2; ++yi)
+					{
+						quint64 key = (quint64(quint16(x[xi])) << 48) |
+								(quint64(quint16(y[yi])) << 32) |
+								(quint64(quint16(s[si])) << 16) |
+								quint64(quint16(o[oi]));
+						bins[key].push_back(i);
+					}
+				}
+			}
+		}
+	}
+
+	// largest bins first
+	std::vector<std::pair<int, const std::vector<int> *> > sortedBins;
+	for(std::map<quint64, std::vector<int> >::const_iterator iter=bins.begin(); iter!=bins.end(); ++iter)
+	{
+		if((int)iter->second.size() >= minClusterSize)
+		{
+			sortedBins.push_back(std::make_pair((int)iter->second.size(), &iter->second));
+		}
+	}
+	std::stable_sort(sortedBins.begin(), sortedBins.end(), houghBinGreater);
+
+	std::vector<unsigned char> assigned(matches.size(), 0);
+	for(unsigned int i=0; i<sortedBins.size(); ++i)
+	{
+		const std::vector<int> & indexes = *sortedBins[i].second;
+		int available = 0;
+		for(unsigned int j=0; j<indexes.size(); ++j)
+		{
+			available += assigned[indexes[j]]?0:1;
+		}
+		if(available >= minClusterSize)
+		{
+			clusters.push_back(DetectionInfo::Matches());
+			clusters.back().reserve(available);
+			for(unsigned int j=0; j<indexes.size(); ++j)
+			{
+				if(!assigned[indexes[j]])
+				{
+					assigned[indexes[j]] = 1;
+					clusters.back().push_back(matches[indexes[j]]);
+				}
+			}
+		}
+	}
+}
+
+// Transform of the object's rectangle in the scene. Returns kRejectedNotValid
+// if a corner is projected too far from the scene, kRejectedByAngle if an
+// angle of the projected rectangle is under Homography/minAngle, otherwise
+// kRejectedUndef.
+static DetectionInfo::RejectedCode checkHomography(
+		const cv::Mat & H,
+		const QRectF & objectRect,
+		const cv::Size & sceneSize,
+		QTransform & hTransform,
+		QPolygonF & rectH)
+{
+	DetectionInfo::RejectedCode code = DetectionInfo::kRejectedUndef;
+	UASSERT(H.cols == 3 && H.rows == 3 && H.type()==CV_64FC1);
+	hTransform = QTransform(
+		H.at<double>(0,0), H.at<double>(1,0), H.at<double>(2,0),
+		H.at<double>(0,1), H.at<double>(1,1), H.at<double>(2,1),
+		H.at<double>(0,2), H.at<double>(1,2), H.at<double>(2,2));
+
+	// is homography valid?
+	// Here we use mapToScene() from QGraphicsItem instead
+	// of QTransform::map() because if the homography is not valid,
+	// huge errors are set by the QGraphicsItem and not by QTransform::map();
+	QGraphicsRectItem item(objectRect);
+	item.setTransform(hTransform);
+	rectH = item.mapToScene(item.rect());
+
+	// If a point is outside of 2x times the surface of the scene, homography is invalid.
+	for(int p=0; p<rectH.size(); ++p)
+	{
+		if((rectH.at(p).x() < -sceneSize.width && rectH.at(p).x() < -objectRect.width()) ||
+		   (rectH.at(p).x() > sceneSize.width*2  && rectH.at(p).x() > objectRect.width()*2) ||
+		   (rectH.at(p).y() < -sceneSize.height  && rectH.at(p).x() < -objectRect.height()) ||
+		   (rectH.at(p).y() > sceneSize.height*2  && rectH.at(p).x() > objectRect.height()*2))
+		{
+			code= DetectionInfo::kRejectedNotValid;
+			break;
+		}
+	}
+
+	// angle
+	if(code == DetectionInfo::kRejectedUndef &&
+	   Settings::getHomography_minAngle() > 0)
+	{
+		for(int a=0; a<rectH.size(); ++a)
+		{
+			//  Find the smaller angle
+			QLineF ab(rectH.at(a).x(), rectH.at(a).y(), rectH.at((a+1)%4).x(), rectH.at((a+1)%4).y());
+			QLineF cb(rectH.at((a+1)%4).x(), rectH.at((a+1)%4).y(), rectH.at((a+2)%4).x(), rectH.at((a+2)%4).y());
+			float angle =  ab.angle(cb);
+			float minAngle = (float)Settings::getHomography_minAngle();
+			if(angle < minAngle ||
+			   angle > 180.0-minAngle)
+			{
+				code = DetectionInfo::kRejectedByAngle;
+				break;
+			}
+		}
+	}
+	return code;
+}
+
 class HomographyThread: public QThread
 {
+public:
+	// One homography hypothesis
+	struct Instance
+	{
+		Instance() : code(DetectionInfo::kRejectedUndef), iterations(0) {}
+		cv::Mat h;
+		DetectionInfo::Matches inliers;
+		DetectionInfo::Matches outliers;
+		DetectionInfo::RejectedCode code;
+		int iterations; // PROSAC
+	};
+
 public:
 	HomographyThread(
-			const QMultiMap<int, int> * matches, // <object, scene>
+			const DetectionInfo::Matches * matches,
 			int objectId,
 			const std::vector<cv::KeyPoint> * kptsA,
 			const std::vector<cv::KeyPoint> * kptsB,
-			const cv::Mat & imageA,   // image only required if opticalFlow is on
-			const cv::Mat & imageB) : // image only required if opticalFlow is on
+			const ObjSignature * object,                 // only required if opticalFlow or multiDetection is on
+			const std::vector<cv::Mat> * scenePyramid,   // only required if opticalFlow is on
+			const cv::Size & sceneSize = cv::Size(),     // only required if multiDetection is on
+			bool multiDetection = false) : // re-estimate on outliers until no more instances are found
 				matches_(matches),
 				objectId_(objectId),
 				kptsA_(kptsA),
 				kptsB_(kptsB),
-				imageA_(imageA),
-				imageB_(imageB),
-				code_(DetectionInfo::kRejectedUndef)
+				object_(object),
+				scenePyramid_(scenePyramid),
+				sceneSize_(sceneSize),
+				multiDetection_(multiDetection)
 	{
 		UASSERT(matches && kptsA && kptsB);
 	}
 	virtual ~HomographyThread() {}
 
 	int getObjectId() const {return objectId_;}
-	const std::vector<int> & getIndexesA() const {return indexesA_;}
-	const std::vector<int> & getIndexesB() const {return indexesB_;}
-	const std::vector<uchar> & getOutlierMask() const {return outlierMask_;}
-	QMultiMap<int, int> getInliers() const {return inliers_;}
-	QMultiMap<int, int> getOutliers() const {return outliers_;}
-	const cv::Mat & getHomography() const {return h_;}
-	DetectionInfo::RejectedCode rejectedCode() const {return code_;}
+	const std::vector<Instance> & getInstances() const {return instances_;}
 
 protected:
 	virtual void run()
@@ -1258,45 +1752,37 @@ protected:
 
 		std::vector<cv::Point2f> mpts_1(matches_->size());
 		std::vector<cv::Point2f> mpts_2(matches_->size());
-		indexesA_.resize(matches_->size());
-		indexesB_.resize(matches_->size());
 
 		UDEBUG("Fill matches...");
-		int j=0;
-		for(QMultiMap<int, int>::const_iterator iter = matches_->begin(); iter!=matches_->end(); ++iter)
+		for(unsigned int j=0; j<matches_->size(); ++j)
 		{
-			UASSERT_MSG(iter.key() < (int)kptsA_->size(), uFormat("key=%d size=%d", iter.key(),(int)kptsA_->size()).c_str());
-			UASSERT_MSG(iter.value() < (int)kptsB_->size(), uFormat("key=%d size=%d", iter.value(),(int)kptsB_->size()).c_str());
-			mpts_1[j] = kptsA_->at(iter.key()).pt;
-			indexesA_[j] = iter.key();
-			mpts_2[j] = kptsB_->at(iter.value()).pt;
-			indexesB_[j] = iter.value();
-			++j;
+			const DetectionInfo::Match & match = matches_->at(j);
+			UASSERT_MSG(match.objectIndex < (int)kptsA_->size(), uFormat("key=%d size=%d", match.objectIndex,(int)kptsA_->size()).c_str());
+			UASSERT_MSG(match.sceneIndex < (int)kptsB_->size(), uFormat("key=%d size=%d", match.sceneIndex,(int)kptsB_->size()).c_str());
+			mpts_1[j] = kptsA_->at(match.objectIndex).pt;
+			mpts_2[j] = kptsB_->at(match.sceneIndex).pt;
 		}
 
 		if((int)mpts_1.size() >= Settings::getHomography_minimumInliers())
 		{
 			if(Settings::getHomography_opticalFlow())
 			{
-				UASSERT(!imageA_.empty() && !imageB_.empty());
-
-				cv::Mat imageA = imageA_;
-				cv::Mat imageB = imageB_;
-				if(imageA_.cols < imageB_.cols && imageA_.rows < imageB_.rows)
-				{
-					// padding, optical flow wants images of the same size
-					imageA = cv::Mat::zeros(imageB_.size(), imageA_.type());
-					imageA_.copyTo(imageA(cv::Rect(0,0,imageA_.cols, imageA_.rows)));
-				}
-				if(imageA.size() == imageB.size())
+				UASSERT(object_ != 0 && scenePyramid_ != 0 && scenePyramid_->size());
+
+				// cached pyramid of the object, padded to scene size
+				std::vector<cv::Mat> objectPyramid = object_->opticalFlowPyramid(
+						scenePyramid_->front().size(),
+						Settings::getHomography_opticalFlowWinSize(),
+						Settings::getHomography_opticalFlowMaxLevel());
+				if(objectPyramid.size())
 				{
 					UDEBUG("Optical flow...");
 					//refine matches
 					std::vector<unsigned char> status;
 					std::vector<float> err;
 					cv::calcOpticalFlowPyrLK(
-							imageA,
-							imageB_,
+							objectPyramid,
+							*scenePyramid_,
 							mpts_1,
 							mpts_2,
 							status,
@@ -1312,77 +1798,157 @@ protected:
 				}
 			}
 
-			UDEBUG("Find homography... begin");
+			// Sequential estimation: each accepted instance's inliers are
+			// masked and the next instance is searched in its outliers.
+			std::vector<int> indexes(mpts_1.size());
+			for(unsigned int k=0; k<indexes.size(); ++k)
+			{
+				indexes[k] = k;
+			}
+			bool prosac = Settings::getHomography_prosac();
+			if(prosac)
+			{
+				// PROSAC: best matches first
+				std::vector<std::pair<float, int> > sorted(indexes.size());
+				for(unsigned int k=0; k<indexes.size(); ++k)
+				{
+					sorted[k] = std::make_pair(matches_->at(k).distance, (int)k);
+				}
+				std::stable_sort(sorted.begin(), sorted.end());
+				for(unsigned int k=0; k<sorted.size(); ++k)
+				{
+					indexes[k] = sorted[k].second;
+				}
+			}
+			while((int)indexes.size() >= Settings::getHomography_minimumInliers())
+			{
+				std::vector<cv::Point2f> pts_1(indexes.size());
+				std::vector<cv::Point2f> pts_2(indexes.size());
+				for(unsigned int k=0; k<indexes.size(); ++k)
+				{
+					pts_1[k] = mpts_1[indexes[k]];
+					pts_2[k] = mpts_2[indexes[k]];
+				}
+
+				Instance instance;
+				std::vector<uchar> outlierMask;
+				UDEBUG("Find homography... begin");
+				if(prosac)
+				{
+					Prosac estimator(
+							(Prosac::Model)Settings::getHomography_prosacModel().split(':').first().toInt(),
+							Settings::getHomography_ransacReprojThr(),
 #if CV_MAJOR_VERSION < 3
-			h_ = findHomography(mpts_1,
-					mpts_2,
-					Settings::getHomographyMethod(),
-					Settings::getHomography_ransacReprojThr(),
-					outlierMask_);
+							2000,
+							0.995,
 #else
-			h_ = findHomography(mpts_1,
-					mpts_2,
-					Settings::getHomographyMethod(),
-					Settings::getHomography_ransacReprojThr(),
-					outlierMask_,
-					Settings::getHomography_maxIterations(),
-					Settings::getHomography_confidence());
+							Settings::getHomography_maxIterations(),
+							Settings::getHomography_confidence(),
 #endif
-			UDEBUG("Find homography... end");
+							Settings::getHomography_prosacLocalOptimization(),
+							Settings::getHomography_prosacSprt(),
+							(unsigned int)Settings::getHomography_prosacSeed());
+					instance.h = estimator.estimate(pts_1, pts_2, outlierMask, &instance.iterations);
+				}
+				else
+				{
+#if CV_MAJOR_VERSION < 3
+					instance.h = findHomography(pts_1,
+							pts_2,
+							Settings::getHomographyMethod(),
+							Settings::getHomography_ransacReprojThr(),
+							outlierMask);
+#else
+					instance.h = findHomography(pts_1,
+							pts_2,
+							Settings::getHomographyMethod(),
+							Settings::getHomography_ransacReprojThr(),
+							outlierMask,
+							Settings::getHomography_maxIterations(),
+							Settings::getHomography_confidence());
+#endif
+				}
+				UDEBUG("Find homography... end");
 
-			UASSERT(outlierMask_.size() == 0 || outlierMask_.size() == mpts_1.size());
-			for(unsigned int k=0; k<mpts_1.size();++k)
-			{
-				if(outlierMask_.size() && outlierMask_.at(k))
+				UASSERT(outlierMask.size() == 0 || outlierMask.size() == pts_1.size());
+				std::vector<int> outlierIndexes;
+				instance.inliers.reserve(pts_1.size());
+				for(unsigned int k=0; k<pts_1.size();++k)
 				{
-					inliers_.insert(indexesA_[k], indexesB_[k]);
+					if(outlierMask.size() && outlierMask.at(k))
+					{
+						instance.inliers.push_back(matches_->at(indexes[k]));
+					}
+					else
+					{
+						instance.outliers.push_back(matches_->at(indexes[k]));
+						outlierIndexes.push_back(indexes[k]);
+					}
 				}
-				else
+
+				if(instance.inliers.size() == outlierMask.size() && !instance.h.empty())
 				{
-					outliers_.insert(indexesA_[k], indexesB_[k]);
+					if(Settings::getHomography_ignoreWhenAllInliers() || cv::countNonZero(instance.h) < 1)
+					{
+						// ignore homography when all features are inliers
+						instance.h = cv::Mat();
+						instance.code = DetectionInfo::kRejectedAllInliers;
+					}
 				}
-			}
 
-			if(inliers_.size() == (int)outlierMask_.size() && !h_.empty())
-			{
-				if(Settings::getHomography_ignoreWhenAllInliers() || cv::countNonZero(h_) < 1)
+				bool found = !instance.h.empty() && (int)instance.inliers.size() >= Settings::getHomography_minimumInliers();
+				if(found && multiDetection_)
+				{
+					// next instance searched in the outliers only if this one is valid
+					UASSERT(object_ != 0);
+					QTransform hTransform;
+					QPolygonF rectH;
+					found = checkHomography(instance.h, object_->rect(), sceneSize_, hTransform, rectH) == DetectionInfo::kRejectedUndef;
+				}
+				instances_.push_back(instance);
+				if(!multiDetection_ || !found)
 				{
-					// ignore homography when all features are inliers
-					h_ = cv::Mat();
-					code_ = DetectionInfo::kRejectedAllInliers;
+					break;
 				}
+				indexes = outlierIndexes;
 			}
 		}
 		else
 		{
-			code_ = DetectionInfo::kRejectedLowMatches;
+			Instance instance;
+			instance.code = DetectionInfo::kRejectedLowMatches;
+			instances_.push_back(instance);
 		}
 
 		//UINFO("Homography Object %d time=%d ms", objectIndex_, time.elapsed());
 	}
 private:
-	const QMultiMap<int, int> * matches_;
+	const DetectionInfo::Matches * matches_;
 	int objectId_;
 	const std::vector<cv::KeyPoint> * kptsA_;
 	const std::vector<cv::KeyPoint> * kptsB_;
-	cv::Mat imageA_;
-	cv::Mat imageB_;
-	DetectionInfo::RejectedCode code_;
-
-	std::vector<int> indexesA_;
-	std::vector<int> indexesB_;
-	std::vector<uchar> outlierMask_;
-	QMultiMap<int, int> inliers_;
-	QMultiMap<int, int> outliers_;
-	cv::Mat h_;
+	const ObjSignature * object_;
+	const std::vector<cv::Mat> * scenePyramid_;
+	cv::Size sceneSize_;
+	bool multiDetection_;
+
+	std::vector<Instance> instances_;
 };
 
 void FindObject::detect(const cv::Mat & image)
+{
+	this->detect(image, -1);
+}
+
+void FindObject::detect(const cv::Mat & image, int streamId)
 {
 	QTime time;
 	time.start();
-	DetectionInfo info;
-	this->detect(image, info);
+	QSharedPointer<DetectionInfo> infoPtr(new DetectionInfo());
+	DetectionInfo & info = *infoPtr;
+	info.streamId_ = streamId;
+	this->detect(image, info, requiredFields_);
+	lastSceneSize_ = image.size();
 
 	if(info.objDetected_.size() > 1)
 	{
@@ -1407,19 +1973,66 @@ void FindObject::detect(const cv::Mat & image)
 
 	if(info.objDetected_.size() > 0 || Settings::getGeneral_sendNoObjDetectedEvents())
 	{
-		Q_EMIT objectsFound(info);
+		Q_EMIT objectsFound(infoPtr);
 	}
 }
 
-bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info) const
+void FindObject::resetStream(int streamId)
+{
+	streams_->reset(streamId);
+}
+
+void FindObject::setPendingFrames(int pendingFrames)
+{
+	latencyController_->setPendingFrames(pendingFrames);
+}
+
+bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info, int fields, int maxLatencyMs) const
 {
 	QTime totalTime;
 	totalTime.start();
+	if(maxLatencyMs < 0)
+	{
+		maxLatencyMs = Settings::getGeneral_maxLatencyMs();
+	}
 
-	// reset statistics
+	// reset statistics, the stream of the scene is kept
+	int streamId = info.streamId_;
 	info = DetectionInfo();
+	info.fields_ = fields;
+	info.streamId_ = streamId;
+
+	// Frame gate: the last detection is returned again if the scene didn't change
+	bool gate = Settings::getGeneral_frameGate() && !image.empty();
+	cv::Mat gateThumbnail;
+	float gateDifference = -1.0f;
+	FrameGate * frameGate = 0;
+	if(gate)
+	{
+		frameGate = streams_->frameGate(streamId);
+		gateThumbnail = FrameGate::thumbnail(image, Settings::getGeneral_frameGateSize());
+		bool reusedSuccess = false;
+		if(frameGate->reuse(
+				gateThumbnail,
+				image.size(),
+				fields,
+				Settings::getGeneral_frameGateThreshold(),
+				Settings::getGeneral_frameGateMaxReused(),
+				info,
+				reusedSuccess,
+				gateDifference))
+		{
+			info.reused_ = true;
+			info.streamId_ = streamId;
+			info.timeStamps_.clear();
+			info.timeStamps_.insert(DetectionInfo::kTimeTotal, totalTime.elapsed());
+			info.statistics_.insert("Gate/difference", gateDifference);
+			return reusedSuccess;
+		}
+	}
 
 	bool success = false;
+	int extractedFeatures = 0;
 	if(!image.empty())
 	{
 		//Convert to grayscale
@@ -1435,16 +2048,97 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 
 		// DETECT FEATURES AND EXTRACT DESCRIPTORS
 		UDEBUG("DETECT FEATURES AND EXTRACT DESCRIPTORS FROM THE SCENE");
-		ExtractFeaturesThread extractThread(detector_, extractor_, -1, grayscaleImg);
-		extractThread.start();
-		extractThread.wait();
-		info.sceneKeypoints_ = extractThread.keypoints();
-		info.sceneDescriptors_ = extractThread.descriptors();
-		UASSERT_MSG((int)extractThread.keypoints().size() == extractThread.descriptors().rows, uFormat("%d vs %d", (int)extractThread.keypoints().size(), extractThread.descriptors().rows).c_str());
-		info.timeStamps_.insert(DetectionInfo::kTimeKeypointDetection, extractThread.timeDetection());
-		info.timeStamps_.insert(DetectionInfo::kTimeDescriptorExtraction, extractThread.timeExtraction());
-		info.timeStamps_.insert(DetectionInfo::kTimeSubPixelRefining, extractThread.timeSubPix());
-		info.timeStamps_.insert(DetectionInfo::kTimeSkewAffine, extractThread.timeSkewAffine());
+		// Latency SLO: effort adjusted from the previous frames
+		int sceneMaxFeatures = -1;
+		int sceneAffineCount = -1;
+		bool latencyControl = Settings::getGeneral_targetLatencyMs() > 0;
+		if(latencyControl)
+		{
+			latencyController_->effort(sceneMaxFeatures, sceneAffineCount);
+		}
+		// Incremental extraction: features of the blocks unchanged since
+		// the reference frame are reused, only the changed blocks are extracted
+		bool incremental = Settings::getGeneral_incrementalExtraction() && !Settings::getFeature2D_4Affine();
+		float changedRatio = -1.0f; // -1: whole image
+		cv::Mat extractionMask;
+		std::vector<cv::KeyPoint> reusedKeypoints;
+		cv::Mat reusedDescriptors;
+		IncrementalFeatures * incrementalFeatures = 0;
+		if(incremental)
+		{
+			incrementalFeatures = streams_->incrementalFeatures(streamId);
+			changedRatio = incrementalFeatures->changeMask(
+					grayscaleImg,
+					Settings::getGeneral_incrementalBlockSize(),
+					Settings::getGeneral_incrementalThreshold(),
+					Settings::getGeneral_incrementalMargin(),
+					Settings::getGeneral_incrementalRefreshFrames(),
+					extractionMask,
+					reusedKeypoints,
+					reusedDescriptors);
+			if(changedRatio > Settings::getGeneral_incrementalMaxChangedRatio())
+			{
+				changedRatio = -1.0f;
+			}
+			if(changedRatio < 0.0f)
+			{
+				extractionMask = cv::Mat();
+				reusedKeypoints.clear();
+				reusedDescriptors = cv::Mat();
+			}
+		}
+
+		int maxFeatures = sceneMaxFeatures<0?Settings::getFeature2D_3MaxFeatures():sceneMaxFeatures;
+		if(changedRatio != 0.0f)
+		{
+			// same density of features in the changed blocks
+			int extractMaxFeatures = sceneMaxFeatures;
+			if(changedRatio > 0.0f && maxFeatures > 0)
+			{
+				extractMaxFeatures = std::max(int(float(maxFeatures)*changedRatio+0.5f), 1);
+			}
+			ExtractFeaturesThread extractThread(detector_, extractor_, -1, grayscaleImg, extractMaxFeatures, sceneAffineCount, extractionMask);
+			extractThread.start();
+			extractThread.wait();
+			info.sceneKeypoints_ = extractThread.keypoints();
+			info.sceneDescriptors_ = extractThread.descriptors();
+			UASSERT_MSG((int)extractThread.keypoints().size() == extractThread.descriptors().rows, uFormat("%d vs %d", (int)extractThread.keypoints().size(), extractThread.descriptors().rows).c_str());
+			info.timeStamps_.insert(DetectionInfo::kTimeKeypointDetection, extractThread.timeDetection());
+			info.timeStamps_.insert(DetectionInfo::kTimeDescriptorExtraction, extractThread.timeExtraction());
+			info.timeStamps_.insert(DetectionInfo::kTimeSubPixelRefining, extractThread.timeSubPix());
+			info.timeStamps_.insert(DetectionInfo::kTimeSkewAffine, extractThread.timeSkewAffine());
+		}
+		else
+		{
+			info.timeStamps_.insert(DetectionInfo::kTimeKeypointDetection, 0);
+			info.timeStamps_.insert(DetectionInfo::kTimeDescriptorExtraction, 0);
+			info.timeStamps_.insert(DetectionInfo::kTimeSubPixelRefining, 0);
+			info.timeStamps_.insert(DetectionInfo::kTimeSkewAffine, 0);
+		}
+		if(reusedKeypoints.size())
+		{
+			if(info.sceneKeypoints_.size())
+			{
+				info.sceneKeypoints_.insert(info.sceneKeypoints_.end(), reusedKeypoints.begin(), reusedKeypoints.end());
+				info.sceneDescriptors_.push_back(reusedDescriptors);
+			}
+			else
+			{
+				info.sceneKeypoints_ = reusedKeypoints;
+				info.sceneDescriptors_ = reusedDescriptors;
+			}
+			if(maxFeatures > 0 && (int)info.sceneKeypoints_.size() > maxFeatures)
+			{
+				limitKeypoints(info.sceneKeypoints_, info.sceneDescriptors_, maxFeatures);
+			}
+		}
+		if(incremental)
+		{
+			incrementalFeatures->update(grayscaleImg, extractionMask, info.sceneKeypoints_, info.sceneDescriptors_);
+			info.statistics_.insert("Incremental/changed_ratio", changedRatio<0.0f?1.0f:changedRatio);
+			info.statistics_.insert("Incremental/reused_features", (float)reusedKeypoints.size());
+		}
+		extractedFeatures = info.sceneDescriptors_.rows;
 
 		bool consistentNNData = (vocabulary_->size()!=0 && vocabulary_->wordToObjects().begin().value()!=-1 && Settings::getGeneral_invertedSearch()) ||
 								((vocabulary_->size()==0 || vocabulary_->wordToObjects().begin().value()==-1) && !Settings::getGeneral_invertedSearch());
@@ -1463,7 +2157,25 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 
 		// COMPARE
 		UDEBUG("COMPARE");
-		if((descriptorsValid || vocabularyValid) &&
+		if(maxLatencyMs > 0 && totalTime.elapsed() >= maxLatencyMs &&
+		   (descriptorsValid || vocabularyValid) &&
+		   info.sceneKeypoints_.size() &&
+		   consistentNNData)
+		{
+			UWARN("Deadline of %d ms reached after features extraction (%d ms), objects are not searched.", maxLatencyMs, totalTime.elapsed());
+			success = true;
+			info.partial_ = true;
+			for(QMap<int, ObjSignature*>::const_iterator iter=objects_.constBegin(); iter!=objects_.constEnd(); ++iter)
+			{
+				if(fields & DetectionInfo::kFieldRejected)
+				{
+					info.rejectedInliers_.insert(iter.key(), DetectionInfo::Matches());
+					info.rejectedOutliers_.insert(iter.key(), DetectionInfo::Matches());
+				}
+				info.rejectedCodes_.insert(iter.key(), DetectionInfo::kRejectedNotEvaluated);
+			}
+		}
+		else if((descriptorsValid || vocabularyValid) &&
 			info.sceneKeypoints_.size() &&
 		    consistentNNData)
 		{
@@ -1473,24 +2185,137 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 
 			QMultiMap<int, int> words;
 
+			// Deadline: from the measured cost of matching, reduce the scene features
+			// and the search checks (same ratio for both) so that matching takes at
+			// most half of the remaining time, the other half is kept for verification.
+			int searchChecks = 0; // 0: NearestNeighbor/search_checks
+			if(maxLatencyMs > 0)
+			{
+				float remaining = float(maxLatencyMs - totalTime.elapsed());
+				float estimated = planner_->stageCost(SearchPlanner::kStageMatching) * float(info.sceneDescriptors_.rows);
+				if(estimated > 0.0f && estimated > remaining/2.0f)
+				{
+					float ratio = std::max(std::sqrt(std::max(remaining/2.0f, 0.0f)/estimated), 0.1f);
+					int maxFeatures = std::max(int(float(info.sceneDescriptors_.rows)*ratio), 1);
+					UDEBUG("Deadline: matching estimated to %.1f ms (%.1f ms remaining), keeping %d/%d features",
+							estimated, remaining, maxFeatures, info.sceneDescriptors_.rows);
+					limitKeypoints(info.sceneKeypoints_, info.sceneDescriptors_, maxFeatures);
+					searchChecks = std::max(int(float(Settings::getNearestNeighbor_search_checks())*ratio), 1);
+					info.statistics_.insert("Deadline/features_ratio", ratio);
+					info.statistics_.insert("Deadline/search_checks", searchChecks);
+				}
+			}
+			int sceneFeatures = info.sceneDescriptors_.rows;
+
+			// Scene matched only to descriptors of the most similar objects (inverted search only)
+			bool retrieval = Settings::getGeneral_invertedSearch() && Settings::getGeneral_globalRetrieval() && globalDescriptors_.rows;
+
+			// TF-IDF scores <score, ObjectID> of the objects with matches (inverted search only)
+			bool shortlist = Settings::getGeneral_invertedSearch() && Settings::getGeneral_shortlist() && !retrieval;
+			std::vector<std::pair<float, int> > shortlistScores;
+
+			// Cost based plan (direct search only)
+			bool autoPlan = Settings::getGeneral_autoPlan();
+			SearchPlanner::SceneIndex sceneIndex = SearchPlanner::kSceneIndexNN;
+			int objectsDescriptorsCount = 0;
+			int descriptorBytes = info.sceneDescriptors_.cols * (int)info.sceneDescriptors_.elemSize();
+			if(autoPlan)
+			{
+				planner_->addScene(info.sceneDescriptors_.rows);
+				int invertedRecommended = planner_->lastInvertedSearchRecommendation();
+				if(invertedRecommended >= 0)
+				{
+					info.statistics_.insert("Plan/inverted_search_recommended", invertedRecommended);
+				}
+			}
+
 			if(!Settings::getGeneral_invertedSearch())
 			{
+				if(autoPlan)
+				{
+					for(QMap<int, cv::Mat>::const_iterator iter=objectsDescriptors_.constBegin(); iter!=objectsDescriptors_.constEnd(); ++iter)
+					{
+						objectsDescriptorsCount += iter.value().rows;
+					}
+					float estimatedMs = 0.0f;
+					sceneIndex = planner_->chooseSceneIndex(info.sceneDescriptors_.rows, objectsDescriptorsCount, descriptorBytes, estimatedMs);
+					UDEBUG("Search plan: scene index %s (estimated %.2f ms)", SearchPlanner::sceneIndexName(sceneIndex).toStdString().c_str(), estimatedMs);
+					info.statistics_.insert("Plan/scene_index_brute_force", sceneIndex == SearchPlanner::kSceneIndexBruteForce?1.0f:0.0f);
+					info.statistics_.insert("Plan/estimated_ms", estimatedMs);
+				}
+				vocabulary_->setBruteForce(sceneIndex == SearchPlanner::kSceneIndexBruteForce);
 				vocabulary_->clear();
 				// CREATE INDEX for the scene
 				UDEBUG("CREATE INDEX FOR THE SCENE");
 				words = vocabulary_->addWords(info.sceneDescriptors_, -1);
 				vocabulary_->update();
 				info.timeStamps_.insert(DetectionInfo::kTimeIndexing, time.restart());
-				info.sceneWords_ = words;
-			}
-
-			for(QMap<int, ObjSignature*>::const_iterator iter=objects_.begin(); iter!=objects_.end(); ++iter)
-			{
-				info.matches_.insert(iter.key(), QMultiMap<int, int>());
+				if(fields & DetectionInfo::kFieldSceneWords)
+				{
+					info.sceneWords_ = words;
+				}
 			}
 
 			if(Settings::getGeneral_invertedSearch() || Settings::getGeneral_threads() == 1)
 			{
+				// Matches accumulated by object index of the inverted index (inverted search only)
+				const std::vector<int> & invertedOffsets = vocabulary_->invertedIndexOffsets();
+				const std::vector<Vocabulary::InvertedIndexEntry> & invertedEntries = vocabulary_->invertedIndexEntries();
+				const std::vector<int> & invertedObjects = vocabulary_->invertedIndexObjects();
+				const std::vector<float> & invertedIdf = vocabulary_->invertedIndexIdf();
+				const std::vector<unsigned char> & stopWords = vocabulary_->stopWords();
+				int stopWordsHits = 0;
+				std::vector<DetectionInfo::Matches> objectsMatches;
+				std::vector<float> objectsVotes;
+
+				// Sub-vocabulary of the retrieved objects, words are indexed by
+				// retrievedOffsets[object index] + keypoint index
+				Vocabulary retrievedVocabulary;
+				std::vector<int> retrievedIds;
+				std::vector<int> retrievedOffsets;
+				if(retrieval)
+				{
+					UDEBUG("GLOBAL RETRIEVAL");
+					cv::Mat sceneGlobalDescriptor = vlad_->compute(info.sceneDescriptors_);
+					cv::Mat similarities = globalDescriptors_ * sceneGlobalDescriptor.t(); // cosine similarity (vectors are normalized)
+					std::vector<std::pair<float, int> > ranking(similarities.rows);
+					for(int j=0; j<similarities.rows; ++j)
+					{
+						ranking[j] = std::make_pair(similarities.at<float>(j,0), j);
+					}
+					int topN = Settings::getGeneral_globalRetrievalTopN();
+					if(topN <= 0 || topN > (int)ranking.size())
+					{
+						topN = (int)ranking.size();
+					}
+					std::partial_sort(ranking.begin(), ranking.begin()+topN, ranking.end(), std::greater<std::pair<float, int> >());
+
+					cv::Mat retrievedDescriptors;
+					for(int j=0; j<topN; ++j)
+					{
+						int id = globalDescriptorsIds_[ranking[j].second];
+						retrievedIds.push_back(id);
+						retrievedOffsets.push_back(retrievedDescriptors.rows);
+						retrievedDescriptors.push_back(objects_.value(id)->descriptors());
+					}
+					UDEBUG("Retrieved %d/%d objects (%d descriptors)", topN, (int)ranking.size(), retrievedDescriptors.rows);
+					info.timeStamps_.insert(DetectionInfo::kTimeRetrieval, time.restart());
+
+					// built for one frame only: brute force, no tree or FLANN index to train
+					retrievedVocabulary.setBruteForce(true);
+					retrievedVocabulary.build(retrievedDescriptors);
+					info.timeStamps_.insert(DetectionInfo::kTimeIndexing, time.restart());
+					objectsMatches.resize(retrievedIds.size());
+				}
+				else if(Settings::getGeneral_invertedSearch())
+				{
+					objectsMatches.resize(invertedObjects.size());
+					if(shortlist)
+					{
+						objectsVotes.resize(invertedObjects.size(), 0.0f);
+					}
+				}
+
 				cv::Mat results;
 				cv::Mat dists;
 				// DO NEAREST NEIGHBOR
@@ -1501,14 +2326,18 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 					//match objects to scene
 					results = cv::Mat(objectsDescriptors_.begin().value().rows, k, CV_32SC1); // results index
 					dists = cv::Mat(objectsDescriptors_.begin().value().rows, k, CV_32FC1); // Distance results are CV_32FC1
-					vocabulary_->search(objectsDescriptors_.begin().value(), results, dists, k);
+					vocabulary_->search(objectsDescriptors_.begin().value(), results, dists, k, searchChecks);
 				}
 				else
 				{
 					//match scene to objects
-					results = cv::Mat(info.sceneDescriptors_.rows, k, CV_32SC1); // results index
-					dists = cv::Mat(info.sceneDescriptors_.rows, k, CV_32FC1); // Distance results are CV_32FC1
-					vocabulary_->search(info.sceneDescriptors_, results, dists, k);
+					Vocabulary * vocabulary = retrieval?&retrievedVocabulary:vocabulary_;
+					if(vocabulary->size() >= k)
+					{
+						results = cv::Mat(info.sceneDescriptors_.rows, k, CV_32SC1); // results index
+						dists = cv::Mat(info.sceneDescriptors_.rows, k, CV_32FC1); // Distance results are CV_32FC1
+						vocabulary->search(info.sceneDescriptors_, results, dists, k, searchChecks);
+					}
 				}
 
 				// PROCESS RESULTS
@@ -1520,6 +2349,7 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 					bool matched = false;
 
 					if(Settings::getNearestNeighbor_3nndrRatioUsed() &&
+					   results.at<int>(i,1) >= 0 && // second neighbor found
 					   dists.at<float>(i,0) <= Settings::getNearestNeighbor_4nndrRatio() * dists.at<float>(i,1))
 					{
 						matched = true;
@@ -1555,16 +2385,39 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 					if(matched)
 					{
 						int wordId = results.at<int>(i,0);
-						if(Settings::getGeneral_invertedSearch())
+						if(retrieval)
+						{
+							if(wordId >= 0 && wordId < retrievedVocabulary.size())
+							{
+								int objectIndex = int(std::upper_bound(retrievedOffsets.begin(), retrievedOffsets.end(), wordId) - retrievedOffsets.begin()) - 1;
+								objectsMatches[objectIndex].push_back(DetectionInfo::Match(wordId - retrievedOffsets[objectIndex], i, dists.at<float>(i,0)));
+							}
+						}
+						else if(Settings::getGeneral_invertedSearch() && wordId >= 0 && wordId < (int)stopWords.size() && stopWords[wordId])
+						{
+							// stop word, not discriminative
+							++stopWordsHits;
+						}
+						else if(Settings::getGeneral_invertedSearch())
 						{
-							info.sceneWords_.insertMulti(wordId, i);
-							QList<int> objIds = vocabulary_->wordToObjects().values(wordId);
-							for(int j=0; j<objIds.size(); ++j)
+							if(fields & DetectionInfo::kFieldSceneWords)
 							{
-								// just add unique matches
-								if(vocabulary_->wordToObjects().count(wordId, objIds[j]) == 1)
+								info.sceneWords_.insertMulti(wordId, i);
+							}
+							if(wordId >= 0 && wordId+1 < (int)invertedOffsets.size())
+							{
+								for(int j=invertedOffsets[wordId]; j<invertedOffsets[wordId+1]; ++j)
 								{
-									info.matches_.find(objIds[j]).value().insert(objects_.value(objIds[j])->words().value(wordId), i);
+									// just add unique matches
+									const Vocabulary::InvertedIndexEntry & entry = invertedEntries[j];
+									if(entry.unique)
+									{
+										objectsMatches[entry.objectIndex].push_back(DetectionInfo::Match(entry.keypointIndex, i, dists.at<float>(i,0)));
+										if(shortlist)
+										{
+											objectsVotes[entry.objectIndex] += invertedIdf[wordId];
+										}
+									}
 								}
 							}
 						}
@@ -1577,11 +2430,32 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 
 							if(words.count(wordId) == 1)
 							{
-								info.matches_.find(objectId).value().insert(objectDescriptorIndex, words.value(wordId));
+								info.objMatches_[objectId].push_back(DetectionInfo::Match(objectDescriptorIndex, words.value(wordId), dists.at<float>(i,0)));
 							}
 						}
 					}
 				}
+
+				for(unsigned int j=0; j<objectsMatches.size(); ++j)
+				{
+					if(objectsMatches[j].size())
+					{
+						info.objMatches_[retrieval?retrievedIds[j]:invertedObjects[j]].swap(objectsMatches[j]);
+						if(shortlist)
+						{
+							const std::vector<int> & objectsWords = vocabulary_->invertedIndexObjectsWords();
+							shortlistScores.push_back(std::make_pair(objectsVotes[j] / std::sqrt(float(objectsWords[j])), invertedObjects[j]));
+						}
+					}
+				}
+
+				if(Settings::getGeneral_invertedSearch() && !retrieval && vocabulary_->stopWordsCount())
+				{
+					UDEBUG("Stop words: %d scene descriptors ignored (%d stop words)", stopWordsHits, vocabulary_->stopWordsCount());
+					info.statistics_.insert("StopWords/words", vocabulary_->stopWordsCount());
+					info.statistics_.insert("StopWords/entries_pruned", vocabulary_->stopWordsEntries());
+					info.statistics_.insert("StopWords/scene_hits", stopWordsHits);
+				}
 			}
 			else
 			{
@@ -1601,14 +2475,17 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 
 					for(int k=j; k<j+threadCounts && k<objectsDescriptorsMat.size(); ++k)
 					{
-						threads.push_back(new SearchThread(vocabulary_, objectsDescriptorsId[k], &objectsDescriptorsMat[k], &words));
+						threads.push_back(new SearchThread(vocabulary_, objectsDescriptorsId[k], &objectsDescriptorsMat[k], &words, searchChecks));
 						threads.back()->start();
 					}
 
 					for(int k=0; k<threads.size(); ++k)
 					{
 						threads[k]->wait();
-						info.matches_[threads[k]->getObjectId()] = threads[k]->getMatches();
+						if(threads[k]->getMatches().size())
+						{
+							info.objMatches_.insert(threads[k]->getObjectId(), threads[k]->getMatches());
+						}
 
 						if(info.minMatchedDistance_ == -1 || info.minMatchedDistance_ > threads[k]->getMinMatchedDistance())
 						{
@@ -1625,6 +2502,18 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 			}
 
 			info.timeStamps_.insert(DetectionInfo::kTimeMatching, time.restart());
+			planner_->addStageCost(SearchPlanner::kStageMatching,
+					sceneFeatures,
+					info.timeStamps_.value(DetectionInfo::kTimeIndexing, 0) + info.timeStamps_.value(DetectionInfo::kTimeMatching, 0));
+
+			if(autoPlan && !Settings::getGeneral_invertedSearch())
+			{
+				planner_->addSceneIndexCost(sceneIndex,
+						info.sceneDescriptors_.rows,
+						objectsDescriptorsCount,
+						descriptorBytes,
+						info.timeStamps_.value(DetectionInfo::kTimeIndexing, 0) + info.timeStamps_.value(DetectionInfo::kTimeMatching, 0));
+			}
 
 			// Homographies
 			if(Settings::getHomography_homographyComputed())
@@ -1634,14 +2523,189 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 				int threadCounts = Settings::getGeneral_threads();
 				if(threadCounts == 0)
 				{
-					threadCounts = info.matches_.size();
+					threadCounts = info.objMatches_.size();
+				}
+				QList<int> matchesId;
+				QList<const DetectionInfo::Matches *> matchesList;
+				if(shortlist)
+				{
+					// SHORTLIST: best scores first
+					std::sort(shortlistScores.begin(), shortlistScores.end(), std::greater<std::pair<float, int> >());
+					int topK = Settings::getGeneral_shortlistTopK();
+					float minScore = Settings::getGeneral_shortlistMinScore();
+					for(unsigned int k=0; k<shortlistScores.size(); ++k)
+					{
+						int id = shortlistScores[k].second;
+						if((topK <= 0 || matchesId.size() < topK) && shortlistScores[k].first >= minScore)
+						{
+							matchesId.push_back(id);
+							matchesList.push_back(&info.objMatches_.find(id).value());
+						}
+						else
+						{
+							if(fields & DetectionInfo::kFieldRejected)
+							{
+								info.rejectedInliers_.insert(id, DetectionInfo::Matches());
+								info.rejectedOutliers_.insert(id, DetectionInfo::Matches());
+							}
+							info.rejectedCodes_.insert(id, DetectionInfo::kRejectedShortlist);
+						}
+					}
+					UDEBUG("Shortlist: %d/%d candidates kept", matchesId.size(), (int)shortlistScores.size());
+					info.timeStamps_.insert(DetectionInfo::kTimeShortlist, time.restart());
 				}
-				QList<int> matchesId = info.matches_.keys();
-				QList<QMultiMap<int, int> > matchesList = info.matches_.values();
+				else
+				{
+					for(QMap<int, DetectionInfo::Matches>::const_iterator iter=info.objMatches_.constBegin(); iter!=info.objMatches_.constEnd(); ++iter)
+					{
+						matchesId.push_back(iter.key());
+						matchesList.push_back(&iter.value());
+					}
+				}
+
+				// Pose clustering: one hypothesis per cluster
+				bool houghClustering = Settings::getHomography_houghClustering();
+				std::list<DetectionInfo::Matches> clustersMatches;
+				if(houghClustering)
+				{
+					QList<int> clustersId;
+					QList<const DetectionInfo::Matches *> clustersList;
+					int totalMatches = 0;
+					int clusteredMatches = 0;
+					for(int k=0; k<matchesList.size(); ++k)
+					{
+						int objectId = matchesId[k];
+						UASSERT(objects_.contains(objectId));
+						std::list<DetectionInfo::Matches> clusters;
+						houghClusters(
+								*matchesList[k],
+								objects_.value(objectId)->keypoints(),
+								info.sceneKeypoints_,
+								objects_.value(objectId)->rect(),
+								Settings::getHomography_minimumInliers(),
+								clusters);
+						totalMatches += (int)matchesList[k]->size();
+						if(clusters.empty())
+						{
+							if(fields & DetectionInfo::kFieldRejected)
+							{
+								info.rejectedInliers_.insert(objectId, DetectionInfo::Matches());
+								info.rejectedOutliers_.insert(objectId, DetectionInfo::Matches());
+							}
+							info.rejectedCodes_.insert(objectId, DetectionInfo::kRejectedLowMatches);
+							continue;
+						}
+						if(!Settings::getGeneral_multiDetection())
+						{
+							// keep only the largest cluster
+							clusters.resize(1);
+						}
+						for(std::list<DetectionInfo::Matches>::iterator iter=clusters.begin(); iter!=clusters.end(); ++iter)
+						{
+							clusteredMatches += (int)iter->size();
+							clustersMatches.push_back(DetectionInfo::Matches());
+							clustersMatches.back().swap(*iter);
+							clustersId.push_back(objectId);
+							clustersList.push_back(&clustersMatches.back());
+						}
+					}
+					UDEBUG("Pose clustering: %d clusters, %d/%d matches kept", clustersList.size(), clusteredMatches, totalMatches);
+					info.statistics_.insert("Hough/clusters", clustersList.size());
+					info.statistics_.insert("Hough/matches", totalMatches);
+					info.statistics_.insert("Hough/matches_clustered", clusteredMatches);
+					matchesId = clustersId;
+					matchesList = clustersList;
+				}
+
+				// Best-first verification: candidates without enough matches are
+				// rejected before scheduling, then expected objects first, then
+				// shortlist order or most matches first.
+				QSet<int> expectedIds;
+				QStringList expectedList = Settings::getGeneral_expectedObjects().replace(';', ',').replace(' ', ',').split(',', QString::SkipEmptyParts);
+				for(int k=0; k<expectedList.size(); ++k)
+				{
+					bool ok = false;
+					int id = expectedList[k].toInt(&ok);
+					if(ok)
+					{
+						expectedIds.insert(id);
+					}
+					else
+					{
+						UWARN("Invalid object ID \"%s\" in %s", expectedList[k].toStdString().c_str(), Settings::kGeneral_expectedObjects().toStdString().c_str());
+					}
+				}
+				int lowMatches = 0;
+				{
+					// <<expected, matches>, -index>
+					std::vector<std::pair<std::pair<int, int>, int> > order;
+					for(int k=0; k<matchesList.size(); ++k)
+					{
+						int size = (int)matchesList[k]->size();
+						if(size < Settings::getHomography_minimumInliers())
+						{
+							if(fields & DetectionInfo::kFieldRejected)
+							{
+								info.rejectedInliers_.insert(matchesId[k], DetectionInfo::Matches());
+								info.rejectedOutliers_.insert(matchesId[k], DetectionInfo::Matches());
+							}
+							info.rejectedCodes_.insert(matchesId[k], DetectionInfo::kRejectedLowMatches);
+							++lowMatches;
+						}
+						else
+						{
+							order.push_back(std::make_pair(std::make_pair(expectedIds.contains(matchesId[k])?1:0, shortlist?0:size), -k));
+						}
+					}
+					std::sort(order.begin(), order.end(), std::greater<std::pair<std::pair<int, int>, int> >());
+					QList<int> sortedId;
+					QList<const DetectionInfo::Matches *> sortedList;
+					for(unsigned int k=0; k<order.size(); ++k)
+					{
+						sortedId.push_back(matchesId[-order[k].second]);
+						sortedList.push_back(matchesList[-order[k].second]);
+					}
+					matchesId = sortedId;
+					matchesList = sortedList;
+				}
+				int maxDetections = Settings::getGeneral_maxDetections();
+				int skipped = 0;
+
+				// Without clustering, each thread searches all instances of its object
+				bool multiDetection = Settings::getGeneral_multiDetection() && !houghClustering;
+				int prosacIterations = 0;
+
+				// Scene's optical flow pyramid, shared by all objects
+				std::vector<cv::Mat> scenePyramid;
+				if(Settings::getHomography_opticalFlow() && matchesList.size())
+				{
+					cv::buildOpticalFlowPyramid(
+							grayscaleImg,
+							scenePyramid,
+							cv::Size(Settings::getHomography_opticalFlowWinSize(), Settings::getHomography_opticalFlowWinSize()),
+							Settings::getHomography_opticalFlowMaxLevel(),
+							false);
+				}
+				int notEvaluatedFrom = matchesList.size();
 				for(int i=0; i<matchesList.size(); i+=threadCounts)
 				{
 					UDEBUG("Processing matches %d/%d", i+1, matchesList.size());
 
+					// Deadline: don't start a batch that would finish too late
+					if(maxLatencyMs > 0)
+					{
+						float remaining = float(maxLatencyMs - totalTime.elapsed());
+						if(remaining <= 0.0f || planner_->stageCost(SearchPlanner::kStageVerification) > remaining)
+						{
+							UWARN("Deadline of %d ms reached, %d/%d candidates not verified.", maxLatencyMs, matchesList.size()-i, matchesList.size());
+							info.partial_ = true;
+							notEvaluatedFrom = i;
+							break;
+						}
+					}
+					QTime batchTime;
+					batchTime.start();
+
 					QVector<HomographyThread*> threads;
 
 					UDEBUG("Creating/Starting homography threads (%d)...", threadCounts);
@@ -1650,12 +2714,14 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 						int objectId = matchesId[k];
 						UASSERT(objects_.contains(objectId));
 						threads.push_back(new HomographyThread(
-								&matchesList[k],
+								matchesList[k],
 								objectId,
 								&objects_.value(objectId)->keypoints(),
 								&info.sceneKeypoints_,
-								objects_.value(objectId)->image(),
-								grayscaleImg));
+								objects_.value(objectId),
+								&scenePyramid,
+								image.size(),
+								multiDetection));
 						threads.back()->start();
 					}
 					UDEBUG("Started homography threads");
@@ -1666,135 +2732,139 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 						UDEBUG("Processing results of homography thread %d", j);
 
 						int id = threads[j]->getObjectId();
-						QTransform hTransform;
-						DetectionInfo::RejectedCode code = DetectionInfo::kRejectedUndef;
-						if(threads[j]->getHomography().empty())
+						const std::vector<HomographyThread::Instance> & instances = threads[j]->getInstances();
+						for(unsigned int n=0; n<instances.size(); ++n)
 						{
-							code = threads[j]->rejectedCode();
-						}
-						if(code == DetectionInfo::kRejectedUndef &&
-						   threads[j]->getInliers().size() < Settings::getHomography_minimumInliers()	)
-						{
-							code = DetectionInfo::kRejectedLowInliers;
-						}
-						if(code == DetectionInfo::kRejectedUndef)
-						{
-							const cv::Mat & H = threads[j]->getHomography();
-							UASSERT(H.cols == 3 && H.rows == 3 && H.type()==CV_64FC1);
-							hTransform = QTransform(
-								H.at<double>(0,0), H.at<double>(1,0), H.at<double>(2,0),
-								H.at<double>(0,1), H.at<double>(1,1), H.at<double>(2,1),
-								H.at<double>(0,2), H.at<double>(1,2), H.at<double>(2,2));
-
-							// is homography valid?
-							// Here we use mapToScene() from QGraphicsItem instead
-							// of QTransform::map() because if the homography is not valid,
-							// huge errors are set by the QGraphicsItem and not by QTransform::map();
-							UASSERT(objects_.contains(id));
-							QRectF objectRect = objects_.value(id)->rect();
-							QGraphicsRectItem item(objectRect);
-							item.setTransform(hTransform);
-							QPolygonF rectH = item.mapToScene(item.rect());
-
-							// If a point is outside of 2x times the surface of the scene, homography is invalid.
-							for(int p=0; p<rectH.size(); ++p)
+							const HomographyThread::Instance & instance = instances[n];
+							prosacIterations += instance.iterations;
+							QTransform hTransform;
+							QPolygonF rectH;
+							DetectionInfo::RejectedCode code = DetectionInfo::kRejectedUndef;
+							if(instance.h.empty())
 							{
-								if((rectH.at(p).x() < -image.cols && rectH.at(p).x() < -objectRect.width()) ||
-								   (rectH.at(p).x() > image.cols*2  && rectH.at(p).x() > objectRect.width()*2) ||
-								   (rectH.at(p).y() < -image.rows  && rectH.at(p).x() < -objectRect.height()) ||
-								   (rectH.at(p).y() > image.rows*2  && rectH.at(p).x() > objectRect.height()*2))
-								{
-									code= DetectionInfo::kRejectedNotValid;
-									break;
-								}
+								code = instance.code;
 							}
-
-							// angle
 							if(code == DetectionInfo::kRejectedUndef &&
-							   Settings::getHomography_minAngle() > 0)
+							   instance.inliers.size() < Settings::getHomography_minimumInliers()	)
 							{
-								for(int a=0; a<rectH.size(); ++a)
+								code = DetectionInfo::kRejectedLowInliers;
+							}
+							if(code == DetectionInfo::kRejectedUndef)
+							{
+								UASSERT(objects_.contains(id));
+								code = checkHomography(instance.h, objects_.value(id)->rect(), image.size(), hTransform, rectH);
+
+								// multi detection
+								if(code == DetectionInfo::kRejectedUndef &&
+								   Settings::getGeneral_multiDetection())
 								{
-									//  Find the smaller angle
-									QLineF ab(rectH.at(a).x(), rectH.at(a).y(), rectH.at((a+1)%4).x(), rectH.at((a+1)%4).y());
-									QLineF cb(rectH.at((a+1)%4).x(), rectH.at((a+1)%4).y(), rectH.at((a+2)%4).x(), rectH.at((a+2)%4).y());
-									float angle =  ab.angle(cb);
-									float minAngle = (float)Settings::getHomography_minAngle();
-									if(angle < minAngle ||
-									   angle > 180.0-minAngle)
+									int distance = Settings::getGeneral_multiDetectionRadius(); // in pixels
+									// compute distance from previous added same objects...
+									QMultiMap<int, QTransform>::iterator objIter = info.objDetected_.find(id);
+									for(;objIter!=info.objDetected_.end() && objIter.key() == id; ++objIter)
 									{
-										code = DetectionInfo::kRejectedByAngle;
-										break;
+										qreal dx = objIter.value().m31() - hTransform.m31();
+										qreal dy = objIter.value().m32() - hTransform.m32();
+										int d = (int)sqrt(dx*dx + dy*dy);
+										if(d < distance)
+										{
+											distance = d;
+										}
+									}
+
+									if(distance < Settings::getGeneral_multiDetectionRadius())
+									{
+										code = DetectionInfo::kRejectedSuperposed;
 									}
 								}
-							}
 
-							// multi detection
-							if(code == DetectionInfo::kRejectedUndef &&
-							   Settings::getGeneral_multiDetection())
-							{
-								int distance = Settings::getGeneral_multiDetectionRadius(); // in pixels
-								// Get the outliers and recompute homography with them
-								matchesList.push_back(threads[j]->getOutliers());
-								matchesId.push_back(id);
-
-								// compute distance from previous added same objects...
-								QMultiMap<int, QTransform>::iterator objIter = info.objDetected_.find(id);
-								for(;objIter!=info.objDetected_.end() && objIter.key() == id; ++objIter)
+								// Corners visible
+								if(code == DetectionInfo::kRejectedUndef &&
+								   Settings::getHomography_allCornersVisible())
 								{
-									qreal dx = objIter.value().m31() - hTransform.m31();
-									qreal dy = objIter.value().m32() - hTransform.m32();
-									int d = (int)sqrt(dx*dx + dy*dy);
-									if(d < distance)
+									// Now verify if all corners are in the scene
+									QRectF sceneRect(0,0,image.cols, image.rows);
+									for(int p=0; p<rectH.size(); ++p)
 									{
-										distance = d;
+										if(!sceneRect.contains(QPointF(rectH.at(p).x(), rectH.at(p).y())))
+										{
+											code = DetectionInfo::kRejectedCornersOutside;
+											break;
+										}
 									}
 								}
+							}
 
-								if(distance < Settings::getGeneral_multiDetectionRadius())
+							if(code == DetectionInfo::kRejectedUndef)
+							{
+								// Accepted!
+								info.objDetected_.insert(id, hTransform);
+								info.objDetectedSizes_.insert(id, objects_.value(id)->rect().size());
+								if(fields & DetectionInfo::kFieldInliers)
 								{
-									code = DetectionInfo::kRejectedSuperposed;
+									info.objDetectedInliers_.insert(id, instance.inliers);
+									info.objDetectedOutliers_.insert(id, instance.outliers);
 								}
+								info.objDetectedInliersCount_.insert(id, instance.inliers.size());
+								info.objDetectedOutliersCount_.insert(id, instance.outliers.size());
+								info.objDetectedFilePaths_.insert(id, objects_.value(id)->filePath());
 							}
-
-							// Corners visible
-							if(code == DetectionInfo::kRejectedUndef &&
-							   Settings::getHomography_allCornersVisible())
+							else
 							{
-								// Now verify if all corners are in the scene
-								QRectF sceneRect(0,0,image.cols, image.rows);
-								for(int p=0; p<rectH.size(); ++p)
+								//Rejected!
+								if(fields & DetectionInfo::kFieldRejected)
 								{
-									if(!sceneRect.contains(QPointF(rectH.at(p).x(), rectH.at(p).y())))
-									{
-										code = DetectionInfo::kRejectedCornersOutside;
-										break;
-									}
+									info.rejectedInliers_.insert(id, instance.inliers);
+									info.rejectedOutliers_.insert(id, instance.outliers);
 								}
+								info.rejectedCodes_.insert(id, code);
 							}
 						}
+						delete threads[j];
+					}
+					UDEBUG("Processed matches %d", i+1);
 
-						if(code == DetectionInfo::kRejectedUndef)
+					// Early termination
+					bool done = maxDetections > 0 && info.objDetected_.size() >= maxDetections;
+					if(!done && expectedIds.size())
+					{
+						done = true;
+						for(QSet<int>::const_iterator iter=expectedIds.constBegin(); iter!=expectedIds.constEnd(); ++iter)
 						{
-							// Accepted!
-							info.objDetected_.insert(id, hTransform);
-							info.objDetectedSizes_.insert(id, objects_.value(id)->rect().size());
-							info.objDetectedInliers_.insert(id, threads[j]->getInliers());
-							info.objDetectedOutliers_.insert(id, threads[j]->getOutliers());
-							info.objDetectedInliersCount_.insert(id, threads[j]->getInliers().size());
-							info.objDetectedOutliersCount_.insert(id, threads[j]->getOutliers().size());
-							info.objDetectedFilePaths_.insert(id, objects_.value(id)->filePath());
+							if(!info.objDetected_.contains(*iter))
+							{
+								done = false;
+								break;
+							}
 						}
-						else
+					}
+					planner_->addStageCost(SearchPlanner::kStageVerification, 1, batchTime.elapsed());
+
+					if(done && i+threadCounts < matchesList.size())
+					{
+						skipped = matchesList.size() - (i+threadCounts);
+						UDEBUG("Verification done, %d candidates not verified", skipped);
+						notEvaluatedFrom = i+threadCounts;
+						break;
+					}
+				}
+				for(int k=notEvaluatedFrom; k<matchesList.size(); ++k)
+				{
+					if(!info.objDetected_.contains(matchesId[k]) && !info.rejectedCodes_.contains(matchesId[k], DetectionInfo::kRejectedNotEvaluated))
+					{
+						if(fields & DetectionInfo::kFieldRejected)
 						{
-							//Rejected!
-							info.rejectedInliers_.insert(id, threads[j]->getInliers());
-							info.rejectedOutliers_.insert(id, threads[j]->getOutliers());
-							info.rejectedCodes_.insert(id, code);
+							info.rejectedInliers_.insert(matchesId[k], DetectionInfo::Matches());
+							info.rejectedOutliers_.insert(matchesId[k], DetectionInfo::Matches());
 						}
-						delete threads[j];
+						info.rejectedCodes_.insert(matchesId[k], DetectionInfo::kRejectedNotEvaluated);
 					}
-					UDEBUG("Processed matches %d", i+1);
+				}
+				info.statistics_.insert("Verification/low_matches", lowMatches);
+				info.statistics_.insert("Verification/skipped", skipped);
+				if(Settings::getHomography_prosac())
+				{
+					info.statistics_.insert("Homography/prosac_iterations", prosacIterations);
 				}
 				info.timeStamps_.insert(DetectionInfo::kTimeHomography, time.restart());
 			}
@@ -1811,8 +2881,44 @@ bool FindObject::detect(const cv::Mat & image, find_object::DetectionInfo & info
 		}
 	}
 
+	// Release heavy data not requested
+	if(!(fields & DetectionInfo::kFieldSceneKeypoints))
+	{
+		std::vector<cv::KeyPoint>().swap(info.sceneKeypoints_);
+	}
+	if(!(fields & DetectionInfo::kFieldSceneDescriptors))
+	{
+		info.sceneDescriptors_ = cv::Mat();
+	}
+	if(!(fields & DetectionInfo::kFieldMatches))
+	{
+		info.objMatches_.clear();
+	}
+
 	info.timeStamps_.insert(DetectionInfo::kTimeTotal, totalTime.elapsed());
 
+	if(gate)
+	{
+		if(gateDifference >= 0.0f)
+		{
+			info.statistics_.insert("Gate/difference", gateDifference);
+		}
+		if(!info.partial_)
+		{
+			frameGate->update(gateThumbnail, image.size(), info, success);
+		}
+	}
+
+	if(!image.empty() && Settings::getGeneral_targetLatencyMs() > 0)
+	{
+		latencyController_->update(info.timeStamps_.value(DetectionInfo::kTimeTotal), extractedFeatures);
+		int maxFeatures, affineCount;
+		latencyController_->effort(maxFeatures, affineCount);
+		info.statistics_.insert("SLO/max_features", maxFeatures);
+		info.statistics_.insert("SLO/affine_count", affineCount);
+		info.statistics_.insert("SLO/pending_frames", latencyController_->pendingFrames());
+	}
+
 	return success;
 }
 
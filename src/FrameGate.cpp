@@ -0,0 +1,124 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/utilite/ULogger.h"
+#include "FrameGate.h"
+#include <QtCore/QMutexLocker>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+
+namespace find_object {
+
+FrameGate::FrameGate()
+{
+	reset();
+}
+
+void FrameGate::reset()
+{
+	QMutexLocker lock(&mutex_);
+	thumbnail_ = cv::Mat();
+	imageSize_ = cv::Size(0,0);
+	info_ = DetectionInfo();
+	success_ = false;
+	reused_ = 0;
+}
+
+cv::Mat FrameGate::thumbnail(const cv::Mat & image, int width)
+{
+	cv::Mat thumbnail;
+	if(!image.empty())
+	{
+		cv::Mat grayscaleImg;
+		if(image.channels() != 1 || image.depth() != CV_8U)
+		{
+			cv::cvtColor(image, grayscaleImg, cv::COLOR_BGR2GRAY);
+		}
+		else
+		{
+			grayscaleImg = image;
+		}
+		width = std::min(std::max(width, 1), grayscaleImg.cols);
+		int height = std::max(int(float(width*grayscaleImg.rows)/float(grayscaleImg.cols)+0.5f), 1);
+		cv::resize(grayscaleImg, thumbnail, cv::Size(width, height), 0, 0, cv::INTER_AREA);
+	}
+	return thumbnail;
+}
+
+bool FrameGate::reuse(
+		const cv::Mat & thumbnail,
+		const cv::Size & imageSize,
+		int fields,
+		float threshold,
+		int maxReused,
+		DetectionInfo & info,
+		bool & success,
+		float & difference)
+{
+	QMutexLocker lock(&mutex_);
+	difference = -1.0f;
+	if(thumbnail_.empty() ||
+	   thumbnail.empty() ||
+	   imageSize != imageSize_ ||
+	   thumbnail.size() != thumbnail_.size() ||
+	   thumbnail.type() != thumbnail_.type())
+	{
+		return false;
+	}
+
+	// Compared to the frame of the cached detection (not the last frame),
+	// so that slow changes are not missed
+	difference = float(cv::norm(thumbnail, thumbnail_, cv::NORM_L1) / double(thumbnail.total()));
+	if(difference > threshold ||
+	   (info_.fields_ & fields) != fields ||
+	   (maxReused > 0 && reused_ >= maxReused))
+	{
+		return false;
+	}
+
+	++reused_;
+	info = info_;
+	success = success_;
+	UDEBUG("Detection reused (difference=%f, reused %d times)", difference, reused_);
+	return true;
+}
+
+void FrameGate::update(
+		const cv::Mat & thumbnail,
+		const cv::Size & imageSize,
+		const DetectionInfo & info,
+		bool success)
+{
+	QMutexLocker lock(&mutex_);
+	thumbnail_ = thumbnail;
+	imageSize_ = imageSize;
+	info_ = info;
+	success_ = success;
+	reused_ = 0;
+}
+
+} // namespace find_object
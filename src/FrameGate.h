@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FRAMEGATE_H_
+#define FRAMEGATE_H_
+
+#include "find_object/DetectionInfo.h"
+#include <QtCore/QMutex>
+#include <opencv2/core/core.hpp>
+
+namespace find_object {
+
+// Motion and duplicate frame gate (General/frameGate): a small grayscale
+// thumbnail of each scene is compared to the one of the last detection,
+// which is returned again while the scene doesn't change. Thread-safe.
+class FrameGate {
+public:
+	FrameGate();
+	virtual ~FrameGate() {}
+
+	void reset();
+
+	static cv::Mat thumbnail(const cv::Mat & image, int width);
+
+	// Returns true with the cached detection when the mean absolute difference
+	// between the thumbnails is under the threshold, the cached detection has
+	// the requested fields and it was not already reused maxReused times (0
+	// means no limit). difference is -1 if there is no cached detection.
+	bool reuse(
+			const cv::Mat & thumbnail,
+			const cv::Size & imageSize,
+			int fields,
+			float threshold,
+			int maxReused,
+			DetectionInfo & info,
+			bool & success,
+			float & difference);
+
+	void update(
+			const cv::Mat & thumbnail,
+			const cv::Size & imageSize,
+			const DetectionInfo & info,
+			bool success);
+
+private:
+	QMutex mutex_;
+	cv::Mat thumbnail_;
+	cv::Size imageSize_;
+	DetectionInfo info_;
+	bool success_;
+	int reused_; // times info_ has been reused
+};
+
+} // namespace find_object
+
+#endif /* FRAMEGATE_H_ */
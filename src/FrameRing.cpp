@@ -0,0 +1,130 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "FrameRing.h"
+
+namespace find_object {
+
+// Same API on Qt4 and Qt5 (load()/store() are Qt5 only)
+static int atomicLoad(QAtomicInt & value)
+{
+	return value.fetchAndAddOrdered(0);
+}
+static void atomicStore(QAtomicInt & value, int newValue)
+{
+	value.fetchAndStoreOrdered(newValue);
+}
+
+FrameRing::FrameRing(int capacity) :
+	slots_(capacity>1?capacity:2),
+	head_(0),
+	tail_(0),
+	reading_(-1),
+	pushed_(0),
+	dropped_(0),
+	skipped_(0)
+{
+}
+
+bool FrameRing::push(const cv::Mat & frame)
+{
+	int capacity = (int)slots_.size();
+	int head = atomicLoad(head_);
+	pushed_.fetchAndAddOrdered(1);
+	while(true)
+	{
+		int tail = atomicLoad(tail_);
+		if(head - tail < capacity)
+		{
+			break;
+		}
+		// Full: drop the oldest frame. If the consumer moved
+		// the tail in the meantime, try again.
+		if(tail_.testAndSetOrdered(tail, tail+1))
+		{
+			dropped_.fetchAndAddOrdered(1);
+			break;
+		}
+	}
+	if(atomicLoad(reading_) == head - capacity)
+	{
+		// The consumer is still copying the slot we would overwrite
+		dropped_.fetchAndAddOrdered(1);
+		return false;
+	}
+	slots_[head % capacity] = frame;
+	atomicStore(head_, head+1);
+	return true;
+}
+
+cv::Mat FrameRing::pop()
+{
+	int capacity = (int)slots_.size();
+	int tail;
+	int head;
+	while(true)
+	{
+		tail = atomicLoad(tail_);
+		head = atomicLoad(head_);
+		if(tail == head)
+		{
+			return cv::Mat();
+		}
+		// Claim all frames up to the newest one, the producer must
+		// know the newest slot is being read before the claim.
+		atomicStore(reading_, head-1);
+		if(tail_.testAndSetOrdered(tail, head))
+		{
+			break;
+		}
+		atomicStore(reading_, -1);
+	}
+	cv::Mat frame = slots_[(head-1) % capacity];
+	atomicStore(reading_, -1);
+	if(head-1 > tail)
+	{
+		skipped_.fetchAndAddOrdered(head-1-tail);
+	}
+	return frame;
+}
+
+int FrameRing::pushed() const
+{
+	return atomicLoad(pushed_);
+}
+
+int FrameRing::dropped() const
+{
+	return atomicLoad(dropped_);
+}
+
+int FrameRing::skipped() const
+{
+	return atomicLoad(skipped_);
+}
+
+} // namespace find_object
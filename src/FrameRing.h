@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef FRAMERING_H_
+#define FRAMERING_H_
+
+#include <QtCore/QAtomicInt>
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+namespace find_object {
+
+// Fixed-size single-producer/single-consumer ring of frames, lock-free.
+// Latest frame wins: when the ring is full, the producer drops the oldest
+// frame, and the consumer always takes the newest frame, skipping the
+// older ones. Dropped and skipped frames are counted.
+class FrameRing
+{
+public:
+	FrameRing(int capacity);
+	virtual ~FrameRing() {}
+
+	// Producer thread. Returns false if the frame has been dropped.
+	bool push(const cv::Mat & frame);
+	// Consumer thread. Returns an empty image if there is no new frame.
+	cv::Mat pop();
+
+	int capacity() const {return (int)slots_.size();}
+	int pushed() const;
+	int dropped() const; // by the producer (ring full)
+	int skipped() const; // by the consumer (not the newest)
+
+private:
+	std::vector<cv::Mat> slots_;
+	// Monotonic indexes, slot i is slots_[i % capacity]
+	QAtomicInt head_; // next index written by the producer
+	QAtomicInt tail_; // next index read by the consumer
+	QAtomicInt reading_; // index copied by the consumer, -1 if none
+	mutable QAtomicInt pushed_;
+	mutable QAtomicInt dropped_;
+	mutable QAtomicInt skipped_;
+};
+
+} // namespace find_object
+
+#endif /* FRAMERING_H_ */
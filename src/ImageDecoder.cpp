@@ -0,0 +1,131 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ImageDecoder.h"
+#include "find_object/utilite/ULogger.h"
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+// IMREAD_REDUCED_* flags are available since OpenCV 3.2
+#if CV_MAJOR_VERSION > 3 || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2)
+#define FINDOBJECT_IMREAD_REDUCED
+#endif
+
+namespace find_object {
+
+static int decodeFlags(bool grayscale, int reduction)
+{
+#ifdef FINDOBJECT_IMREAD_REDUCED
+	switch(reduction)
+	{
+	case 2:
+		return grayscale?cv::IMREAD_REDUCED_GRAYSCALE_2:cv::IMREAD_REDUCED_COLOR_2;
+	case 4:
+		return grayscale?cv::IMREAD_REDUCED_GRAYSCALE_4:cv::IMREAD_REDUCED_COLOR_4;
+	case 8:
+		return grayscale?cv::IMREAD_REDUCED_GRAYSCALE_8:cv::IMREAD_REDUCED_COLOR_8;
+	default:
+		break;
+	}
+#endif
+	return grayscale?cv::IMREAD_GRAYSCALE:cv::IMREAD_COLOR;
+}
+
+static cv::Mat reduce(const cv::Mat & image, int reduction)
+{
+#ifndef FINDOBJECT_IMREAD_REDUCED
+	if(reduction > 1 && !image.empty())
+	{
+		cv::Mat reduced;
+		cv::resize(image, reduced, cv::Size((image.cols+reduction-1)/reduction, (image.rows+reduction-1)/reduction), 0, 0, cv::INTER_AREA);
+		return reduced;
+	}
+#endif
+	return image;
+}
+
+ImageDecoder::ImageDecoder() :
+	sourceSize_(0,0),
+	reduction_(1)
+{
+}
+
+cv::Mat ImageDecoder::decodeReduced(const std::vector<unsigned char> & buf, bool grayscale, int reduction)
+{
+	if(reduction <= 1 && !grayscale)
+	{
+		return cv::imdecode(buf, cv::IMREAD_UNCHANGED);
+	}
+	return reduce(cv::imdecode(buf, decodeFlags(grayscale, reduction)), reduction);
+}
+
+cv::Mat ImageDecoder::readReduced(const std::string & path, bool grayscale, int reduction)
+{
+	return reduce(cv::imread(path, decodeFlags(grayscale, reduction)), reduction);
+}
+
+cv::Mat ImageDecoder::decode(const std::vector<unsigned char> & buf, bool grayscale, const cv::Size & targetSize)
+{
+	reduction_ = selectReduction(sourceSize_, targetSize);
+	cv::Mat image = decodeReduced(buf, grayscale, reduction_);
+	updateSourceSize(image);
+	return image;
+}
+
+cv::Mat ImageDecoder::read(const std::string & path, bool grayscale, const cv::Size & targetSize)
+{
+	reduction_ = selectReduction(sourceSize_, targetSize);
+	cv::Mat image = readReduced(path, grayscale, reduction_);
+	updateSourceSize(image);
+	return image;
+}
+
+int ImageDecoder::selectReduction(const cv::Size & sourceSize, const cv::Size & targetSize)
+{
+	int reduction = 1;
+	if(targetSize.width > 0 && targetSize.height > 0 && sourceSize.width > 0 && sourceSize.height > 0)
+	{
+		while(reduction < 8 &&
+			  sourceSize.width/(reduction*2) >= targetSize.width &&
+			  sourceSize.height/(reduction*2) >= targetSize.height)
+		{
+			reduction *= 2;
+		}
+	}
+	return reduction;
+}
+
+void ImageDecoder::updateSourceSize(const cv::Mat & image)
+{
+	if(!image.empty())
+	{
+		sourceSize_ = cv::Size(image.cols*reduction_, image.rows*reduction_);
+	}
+	UDEBUG("reduction=%d source=%dx%d", reduction_, sourceSize_.width, sourceSize_.height);
+}
+
+} // namespace find_object
@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef IMAGEDECODER_H_
+#define IMAGEDECODER_H_
+
+#include <opencv2/core/core.hpp>
+#include <string>
+#include <vector>
+
+namespace find_object {
+
+// Decode images directly to grayscale and/or at reduced resolution
+// (1/2, 1/4 or 1/8, done while decoding for JPEG). The reduction can be
+// chosen from the size requested: the size of the last source image is
+// used to select the largest reduction keeping the image at least as
+// large as the size requested.
+class ImageDecoder
+{
+public:
+	ImageDecoder();
+
+	// targetSize: 0 means full resolution
+	cv::Mat decode(const std::vector<unsigned char> & buf, bool grayscale, const cv::Size & targetSize = cv::Size());
+	cv::Mat read(const std::string & path, bool grayscale, const cv::Size & targetSize = cv::Size());
+	int lastReduction() const {return reduction_;}
+
+	// reduction: 1, 2, 4 or 8
+	static cv::Mat decodeReduced(const std::vector<unsigned char> & buf, bool grayscale, int reduction);
+	static cv::Mat readReduced(const std::string & path, bool grayscale, int reduction);
+	// Largest reduction (1, 2, 4 or 8) keeping sourceSize at least as large as targetSize
+	static int selectReduction(const cv::Size & sourceSize, const cv::Size & targetSize);
+
+private:
+	void updateSourceSize(const cv::Mat & image);
+
+private:
+	cv::Size sourceSize_; // size of the last image at full resolution
+	int reduction_; // reduction of the last image
+};
+
+} // namespace find_object
+
+#endif /* IMAGEDECODER_H_ */
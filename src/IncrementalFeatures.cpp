@@ -0,0 +1,146 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/utilite/ULogger.h"
+#include "IncrementalFeatures.h"
+#include <QtCore/QMutexLocker>
+#include <algorithm>
+
+namespace find_object {
+
+IncrementalFeatures::IncrementalFeatures()
+{
+	reset();
+}
+
+void IncrementalFeatures::reset()
+{
+	QMutexLocker lock(&mutex_);
+	reference_ = cv::Mat();
+	keypoints_.clear();
+	descriptors_ = cv::Mat();
+	frames_ = 0;
+}
+
+float IncrementalFeatures::changeMask(
+		const cv::Mat & image,
+		int blockSize,
+		float threshold,
+		int margin,
+		int refreshFrames,
+		cv::Mat & mask,
+		std::vector<cv::KeyPoint> & keypoints,
+		cv::Mat & descriptors) const
+{
+	mask = cv::Mat();
+	keypoints.clear();
+	descriptors = cv::Mat();
+
+	QMutexLocker lock(&mutex_);
+	if(image.empty() ||
+	   reference_.empty() ||
+	   reference_.size() != image.size() ||
+	   reference_.type() != image.type() ||
+	   (int)keypoints_.size() != descriptors_.rows ||
+	   (refreshFrames > 0 && frames_ >= refreshFrames))
+	{
+		return -1.0f;
+	}
+
+	blockSize = std::max(blockSize, 1);
+	margin = std::max(margin, 0);
+	cv::Mat diff;
+	cv::absdiff(image, reference_, diff);
+
+	cv::Rect imageRect(0, 0, image.cols, image.rows);
+	mask = cv::Mat::zeros(image.size(), CV_8UC1);
+	int changedBlocks = 0;
+	for(int y=0; y<image.rows; y+=blockSize)
+	{
+		for(int x=0; x<image.cols; x+=blockSize)
+		{
+			cv::Rect block = cv::Rect(x, y, blockSize, blockSize) & imageRect;
+			if(cv::mean(diff(block))[0] > threshold)
+			{
+				cv::Rect guard = cv::Rect(block.x-margin, block.y-margin, block.width+2*margin, block.height+2*margin) & imageRect;
+				mask(guard).setTo(cv::Scalar(255));
+				++changedBlocks;
+			}
+		}
+	}
+	float ratio = changedBlocks?float(cv::countNonZero(mask))/float(image.total()):0.0f;
+
+	// Reference features outside the extraction mask are kept
+	std::vector<int> kept;
+	kept.reserve(keypoints_.size());
+	for(unsigned int i=0; i<keypoints_.size(); ++i)
+	{
+		int x = std::min(std::max(int(keypoints_[i].pt.x), 0), image.cols-1);
+		int y = std::min(std::max(int(keypoints_[i].pt.y), 0), image.rows-1);
+		if(changedBlocks == 0 || mask.at<unsigned char>(y, x) == 0)
+		{
+			kept.push_back(i);
+		}
+	}
+	keypoints.resize(kept.size());
+	if(kept.size())
+	{
+		descriptors = cv::Mat((int)kept.size(), descriptors_.cols, descriptors_.type());
+		for(unsigned int i=0; i<kept.size(); ++i)
+		{
+			keypoints[i] = keypoints_[kept[i]];
+			descriptors_.row(kept[i]).copyTo(descriptors.row(i));
+		}
+	}
+	UDEBUG("changed blocks=%d ratio=%f kept=%d/%d", changedBlocks, ratio, (int)kept.size(), (int)keypoints_.size());
+	return ratio;
+}
+
+void IncrementalFeatures::update(
+		const cv::Mat & image,
+		const cv::Mat & mask,
+		const std::vector<cv::KeyPoint> & keypoints,
+		const cv::Mat & descriptors)
+{
+	QMutexLocker lock(&mutex_);
+	if(mask.empty() || reference_.size() != image.size() || reference_.type() != image.type())
+	{
+		reference_ = image.clone();
+		frames_ = 0;
+	}
+	else
+	{
+		// Changes under the threshold accumulate against the
+		// reference until the block is extracted again
+		image.copyTo(reference_, mask);
+		++frames_;
+	}
+	keypoints_ = keypoints;
+	descriptors_ = descriptors.clone();
+}
+
+} // namespace find_object
@@ -0,0 +1,82 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCREMENTALFEATURES_H_
+#define INCREMENTALFEATURES_H_
+
+#include <QtCore/QMutex>
+#include <opencv2/core/core.hpp>
+#include <opencv2/features2d/features2d.hpp>
+#include <vector>
+
+namespace find_object {
+
+// Features of a reference scene frame, for incremental extraction
+// (General/incrementalExtraction): the scene is compared block by block
+// to the reference, only changed blocks are extracted again and the
+// features of the other blocks are reused. Thread-safe.
+class IncrementalFeatures {
+public:
+	IncrementalFeatures();
+	virtual ~IncrementalFeatures() {}
+
+	void reset();
+
+	// Returns the ratio of the image to extract again (0 to 1), with the
+	// extraction mask (changed blocks dilated by the margin) and the
+	// reference features outside the mask. Returns -1 if the whole image
+	// should be extracted (no reference, other size or refresh after
+	// refreshFrames frames, 0 means never).
+	float changeMask(
+			const cv::Mat & image,
+			int blockSize,
+			float threshold,
+			int margin,
+			int refreshFrames,
+			cv::Mat & mask,
+			std::vector<cv::KeyPoint> & keypoints,
+			cv::Mat & descriptors) const;
+
+	// Update the reference with the scene features, the image is copied
+	// only inside the extraction mask (empty mask: whole image extracted).
+	void update(
+			const cv::Mat & image,
+			const cv::Mat & mask,
+			const std::vector<cv::KeyPoint> & keypoints,
+			const cv::Mat & descriptors);
+
+private:
+	mutable QMutex mutex_;
+	cv::Mat reference_;
+	std::vector<cv::KeyPoint> keypoints_;
+	cv::Mat descriptors_;
+	int frames_; // frames since the last whole image extraction
+};
+
+} // namespace find_object
+
+#endif /* INCREMENTALFEATURES_H_ */
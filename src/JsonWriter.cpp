@@ -93,10 +93,10 @@ void JsonWriter::write(const DetectionInfo & info, const QString & path)
 			root["objects"] = detections;
 		}
 
-		if(info.matches_.size())
+		if(info.objMatches_.size())
 		{
 			Json::Value matchesValues;
-			const QMap<int, QMultiMap<int, int> > & matches = info.matches_;
+			const QMap<int, QMultiMap<int, int> > matches = info.matches();
 			for(QMap<int, QMultiMap<int, int> >::const_iterator iter = matches.constBegin();
 				iter != matches.end();
 				++iter)
@@ -108,6 +108,33 @@ void JsonWriter::write(const DetectionInfo & info, const QString & path)
 			root["matches"] = matchesValues;
 		}
 
+		if(info.partial_)
+		{
+			root["partial"] = true;
+		}
+
+		if(info.reused_)
+		{
+			root["reused"] = true;
+		}
+
+		if(info.streamId_ >= 0)
+		{
+			root["stream_id"] = info.streamId_;
+		}
+
+		if(info.statistics_.size())
+		{
+			Json::Value statistics;
+			for(QMap<QString, float>::const_iterator iter = info.statistics_.constBegin();
+				iter != info.statistics_.constEnd();
+				++iter)
+			{
+				statistics[iter.key().toStdString()] = iter.value();
+			}
+			root["statistics"] = statistics;
+		}
+
 		// write in a nice readible way
 		Json::StyledWriter styledWriter;
 		//std::cout << styledWriter.write(root);
@@ -0,0 +1,150 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/Settings.h"
+#include "find_object/utilite/ULogger.h"
+#include "LatencyController.h"
+#include <QtCore/QMutexLocker>
+#include <algorithm>
+
+namespace find_object {
+
+// Weight of the last measure in the latency moving average
+static const float kSmoothing = 0.3f;
+// Effort is increased only under this ratio of the target
+static const float kHeadroom = 0.8f;
+// Maximum relative change of the features budget per frame
+static const float kMaxIncrease = 1.1f;
+static const float kMaxDecrease = 0.5f;
+
+LatencyController::LatencyController()
+{
+	reset();
+}
+
+void LatencyController::reset()
+{
+	QMutexLocker lock(&mutex_);
+	latency_ = 0.0f;
+	maxFeatures_ = 0.0f;
+	affineCount_ = 0;
+	pendingFrames_ = 0;
+}
+
+void LatencyController::effort(int & maxFeatures, int & affineCount) const
+{
+	QMutexLocker lock(&mutex_);
+	maxFeatures = maxFeatures_ > 0.0f?int(maxFeatures_):-1;
+	affineCount = affineCount_ > 0?affineCount_:-1;
+}
+
+bool LatencyController::update(float latencyMs, int features)
+{
+	int target = Settings::getGeneral_targetLatencyMs();
+	if(target <= 0)
+	{
+		return false;
+	}
+	int minFeatures = Settings::getGeneral_targetLatencyMinFeatures();
+	int upperFeatures = Settings::getFeature2D_3MaxFeatures(); // 0 means no limit
+	bool affine = Settings::getFeature2D_4Affine();
+	int upperAffineCount = std::max(Settings::getFeature2D_5AffineCount(), 1);
+
+	QMutexLocker lock(&mutex_);
+	if(maxFeatures_ <= 0.0f)
+	{
+		maxFeatures_ = float(upperFeatures > 0?upperFeatures:std::max(features, minFeatures));
+	}
+	if(affineCount_ <= 0 || affineCount_ > upperAffineCount)
+	{
+		affineCount_ = upperAffineCount;
+	}
+	latency_ = latency_ > 0.0f?latency_ + kSmoothing*(latencyMs - latency_):latencyMs;
+
+	// Load shedding: frames waiting in the queue wait for this one
+	float effectiveTarget = float(target) / float(1 + pendingFrames_);
+
+	float oldMaxFeatures = maxFeatures_;
+	int oldAffineCount = affineCount_;
+	if(latency_ > effectiveTarget)
+	{
+		// ASIFT views are the most expensive, reduce them first
+		if(affine && affineCount_ > 1)
+		{
+			--affineCount_;
+		}
+		else
+		{
+			maxFeatures_ = std::max(float(minFeatures), maxFeatures_ * std::max(kMaxDecrease, effectiveTarget/latency_));
+		}
+	}
+	else if(latency_ < kHeadroom*effectiveTarget)
+	{
+		// increase the budget only if it limits the features extracted
+		if((upperFeatures <= 0 || maxFeatures_ < float(upperFeatures)) && float(features) >= 0.95f*maxFeatures_)
+		{
+			maxFeatures_ *= std::min(kMaxIncrease, kHeadroom*effectiveTarget/latency_);
+			if(upperFeatures > 0)
+			{
+				maxFeatures_ = std::min(maxFeatures_, float(upperFeatures));
+			}
+		}
+		else if(affine && affineCount_ < upperAffineCount)
+		{
+			++affineCount_;
+		}
+	}
+
+	bool adjusted = int(oldMaxFeatures) != int(maxFeatures_) || oldAffineCount != affineCount_;
+	if(adjusted)
+	{
+		UINFO("Latency %.1f ms (target %.1f ms, %d frames pending): max features %d -> %d, affine count %d -> %d",
+				latency_, effectiveTarget, pendingFrames_,
+				int(oldMaxFeatures), int(maxFeatures_),
+				oldAffineCount, affineCount_);
+		if(oldAffineCount != affineCount_)
+		{
+			// wait for a new measure with the new affine count
+			latency_ = 0.0f;
+		}
+	}
+	return adjusted;
+}
+
+void LatencyController::setPendingFrames(int pendingFrames)
+{
+	QMutexLocker lock(&mutex_);
+	pendingFrames_ = std::max(pendingFrames, 0);
+}
+
+int LatencyController::pendingFrames() const
+{
+	QMutexLocker lock(&mutex_);
+	return pendingFrames_;
+}
+
+} // namespace find_object
@@ -0,0 +1,64 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LATENCYCONTROLLER_H_
+#define LATENCYCONTROLLER_H_
+
+#include <QtCore/QMutex>
+
+namespace find_object {
+
+// Feedback controller tracking a target detection latency (General/targetLatencyMs)
+// by adjusting the scene extraction effort: the maximum features and the
+// number of ASIFT tilts, between bounds. Thread-safe.
+class LatencyController {
+public:
+	LatencyController();
+	virtual ~LatencyController() {}
+
+	void reset();
+
+	// Effort for the next frame, -1 means the value of the parameter
+	void effort(int & maxFeatures, int & affineCount) const;
+	// Latency measured for a frame with the number of features extracted.
+	// Returns true if the effort has been adjusted.
+	bool update(float latencyMs, int features);
+	// Frames waiting in the input queue: the target is divided to drain the queue
+	void setPendingFrames(int pendingFrames);
+	int pendingFrames() const;
+
+private:
+	mutable QMutex mutex_;
+	float latency_; // ms, exponential moving average, 0 if unknown
+	float maxFeatures_; // 0 if not initialized
+	int affineCount_; // 0 if not initialized
+	int pendingFrames_;
+};
+
+} // namespace find_object
+
+#endif /* LATENCYCONTROLLER_H_ */
@@ -137,6 +137,7 @@ MainWindow::MainWindow(FindObject * findObject, Camera * camera, QWidget * paren
 		ui_->actionCamera_from_directory_of_images->setVisible(false);
 		ui_->actionLoad_scene_from_file->setVisible(false);
 	}
+	connect(camera_, SIGNAL(streamStarted(int)), findObject_, SLOT(resetStream(int)));
 
 #if CV_MAJOR_VERSION < 3
 	if(cv::gpu::getCudaEnabledDeviceCount() == 0)
@@ -350,7 +351,7 @@ void MainWindow::setupTCPServer()
 		delete tcpServer_;
 	}
 	tcpServer_ = new TcpServer(Settings::getGeneral_port(), this);
-	connect(this, SIGNAL(objectsFound(find_object::DetectionInfo)), tcpServer_, SLOT(publishDetectionInfo(find_object::DetectionInfo)));
+	connect(this, SIGNAL(objectsFound(find_object::DetectionInfoPtr)), tcpServer_, SLOT(publishDetectionInfo(find_object::DetectionInfoPtr)));
 	ui_->label_ipAddress->setText(tcpServer_->getHostAddress().toString());
 	ui_->label_port->setNum(tcpServer_->getPort());
 	UINFO("Detection sent on port: %d (IP=%s)", tcpServer_->getPort(), tcpServer_->getHostAddress().toString().toStdString().c_str());
@@ -1304,7 +1305,10 @@ void MainWindow::update(const cv::Mat & image)
 
 	QTime guiRefreshTime;
 
-	DetectionInfo info;
+	QSharedPointer<DetectionInfo> infoPtr(new DetectionInfo());
+	DetectionInfo & info = *infoPtr;
+	info.streamId_ = camera_->lastStreamId();
+	findObject_->setPendingFrames(camera_->imagesBuffered());
 	if(findObject_->detect(sceneImage_, info))
 	{
 		guiRefreshTime.start();
@@ -1324,29 +1328,33 @@ void MainWindow::update(const cv::Mat & image)
 		ui_->label_vocabularySize->setNum(findObject_->vocabulary()->size());
 
 		// Colorize features matched
-		const QMap<int, QMultiMap<int, int> > & matches = info.matches_;
+		const QMap<int, QMultiMap<int, int> > matches = info.matches();
+		const QMultiMap<int, QMultiMap<int, int> > allRejectedInliers = info.rejectedInliers();
+		const QMultiMap<int, QMultiMap<int, int> > allRejectedOutliers = info.rejectedOutliers();
 		QMap<int, int> scores;
 		int maxScoreId = -1;
 		int maxScore = 0;
-		for(QMap<int, QMultiMap<int, int> >::const_iterator jter=matches.constBegin(); jter!=matches.end();++jter)
+		for(QMap<int, ObjWidget*>::const_iterator jter=objWidgets_.constBegin(); jter!=objWidgets_.constEnd();++jter)
 		{
-			scores.insert(jter.key(), jter.value().size());
-			if(maxScoreId == -1 || maxScore < jter.value().size())
+			// objects without matches are not in the detection info
+			int id = jter.key();
+			const QMultiMap<int, int> objMatches = matches.value(id);
+			scores.insert(id, objMatches.size());
+			if(maxScoreId == -1 || maxScore < objMatches.size())
 			{
-				maxScoreId = jter.key();
-				maxScore = jter.value().size();
+				maxScoreId = id;
+				maxScore = objMatches.size();
 			}
 
-			int id = jter.key();
 			QLabel * label = ui_->dockWidget_objects->findChild<QLabel*>(QString("%1detection").arg(id));
 			if(!Settings::getHomography_homographyComputed())
 			{
-				label->setText(QString("%1 matches").arg(jter.value().size()));
+				label->setText(QString("%1 matches").arg(objMatches.size()));
 
-				ObjWidget * obj = objWidgets_.value(id);
+				ObjWidget * obj = jter.value();
 				UASSERT(obj != 0);
 
-				for(QMultiMap<int, int>::const_iterator iter = jter.value().constBegin(); iter!= jter.value().constEnd(); ++iter)
+				for(QMultiMap<int, int>::const_iterator iter = objMatches.constBegin(); iter!= objMatches.constEnd(); ++iter)
 				{
 					obj->setKptColor(iter.key(), obj->color());
 					ui_->imageView_source->setKptColor(iter.value(), obj->color());
@@ -1360,12 +1368,12 @@ void MainWindow::update(const cv::Mat & image)
 			{
 				// Homography could not be computed...
 				QLabel * label = ui_->dockWidget_objects->findChild<QLabel*>(QString("%1detection").arg(id));
-				QMultiMap<int, int> rejectedInliers = info.rejectedInliers_.value(id);
-				QMultiMap<int, int> rejectedOutliers = info.rejectedOutliers_.value(id);
-				int rejectedCode = info.rejectedCodes_.value(id);
+				QMultiMap<int, int> rejectedInliers = allRejectedInliers.value(id);
+				QMultiMap<int, int> rejectedOutliers = allRejectedOutliers.value(id);
+				int rejectedCode = info.rejectedCodes_.value(id, DetectionInfo::kRejectedLowMatches);
 				if(rejectedCode == DetectionInfo::kRejectedLowMatches)
 				{
-					label->setText(QString("Too low matches (%1)").arg(jter.value().size()));
+					label->setText(QString("Too low matches (%1)").arg(objMatches.size()));
 				}
 				else if(rejectedCode == DetectionInfo::kRejectedAllInliers)
 				{
@@ -1387,6 +1395,14 @@ void MainWindow::update(const cv::Mat & image)
 				{
 					label->setText(QString("Angle too small (%1 in %2 out)").arg(rejectedInliers.size()).arg(rejectedOutliers.size()));
 				}
+				else if(rejectedCode == DetectionInfo::kRejectedShortlist)
+				{
+					label->setText(QString("Not in shortlist (%1 matches)").arg(objMatches.size()));
+				}
+				else if(rejectedCode == DetectionInfo::kRejectedNotEvaluated)
+				{
+					label->setText(QString("Not evaluated (%1 matches)").arg(objMatches.size()));
+				}
 			}
 		}
 
@@ -1398,18 +1414,18 @@ void MainWindow::update(const cv::Mat & image)
 		// Add homography rectangles when homographies are computed
 		int maxHomographyScoreId = -1;
 		int maxHomographyScore = 0;
-		QMultiMap<int, QMultiMap<int,int> >::const_iterator inliersIter = info.objDetectedInliers_.constBegin();
-		QMultiMap<int, QMultiMap<int,int> >::const_iterator outliersIter = info.objDetectedOutliers_.constBegin();
+		QMultiMap<int, DetectionInfo::Matches>::const_iterator inliersIter = info.objDetectedInliers_.constBegin();
+		QMultiMap<int, DetectionInfo::Matches>::const_iterator outliersIter = info.objDetectedOutliers_.constBegin();
 		for(QMultiMap<int,QTransform>::iterator iter = info.objDetected_.begin();
 				iter!=info.objDetected_.end();
 				++iter, ++inliersIter, ++outliersIter)
 		{
 			int id = iter.key();
 
-			if(maxHomographyScoreId == -1 || maxHomographyScore < inliersIter.value().size())
+			if(maxHomographyScoreId == -1 || maxHomographyScore < (int)inliersIter.value().size())
 			{
 				maxHomographyScoreId = id;
-				maxHomographyScore = inliersIter.value().size();
+				maxHomographyScore = (int)inliersIter.value().size();
 			}
 
 			ObjWidget * obj = objWidgets_.value(id);
@@ -1440,13 +1456,14 @@ void MainWindow::update(const cv::Mat & image)
 			rectItemObj->setPen(rectPen);
 			obj->addRect(rectItemObj);
 
-			for(QMultiMap<int, int>::const_iterator iter = inliersIter.value().constBegin(); iter!= inliersIter.value().constEnd(); ++iter)
+			const DetectionInfo::Matches & inliers = inliersIter.value();
+			for(unsigned int i=0; i<inliers.size(); ++i)
 			{
-				obj->setKptColor(iter.key(), obj->color());
-				ui_->imageView_source->setKptColor(iter.value(), obj->color());
+				obj->setKptColor(inliers[i].objectIndex, obj->color());
+				ui_->imageView_source->setKptColor(inliers[i].sceneIndex, obj->color());
 				if(!Settings::getGeneral_invertedSearch())
 				{
-					obj->setKptWordID(iter.key(), ui_->imageView_source->words().value(iter.value(), -1));
+					obj->setKptWordID(inliers[i].objectIndex, ui_->imageView_source->words().value(inliers[i].sceneIndex, -1));
 				}
 			}
 
@@ -1458,7 +1475,7 @@ void MainWindow::update(const cv::Mat & image)
 			}
 			else
 			{
-				label->setText(QString("%1 in %2 out").arg(inliersIter.value().size()).arg(outliersIter.value().size()));
+				label->setText(QString("%1 in %2 out").arg((int)inliersIter.value().size()).arg((int)outliersIter.value().size()));
 			}
 		}
 
@@ -1493,17 +1510,13 @@ void MainWindow::update(const cv::Mat & image)
 		QMap<int, int> inlierScores;
 		for(QMap<int, int>::iterator iter=scores.begin(); iter!=scores.end(); ++iter)
 		{
-			QList<QMultiMap<int, int> > values = info.objDetectedInliers_.values(iter.key());
 			int maxValue = 0;
-			if(values.size())
+			QMultiMap<int, DetectionInfo::Matches>::const_iterator jter = info.objDetectedInliers_.constFind(iter.key());
+			for(; jter!=info.objDetectedInliers_.constEnd() && jter.key() == iter.key(); ++jter)
 			{
-				maxValue = values[0].size();
-				for(int i=1; i<values.size(); ++i)
+				if(maxValue < (int)jter.value().size())
 				{
-					if(maxValue < values[i].size())
-					{
-						maxValue = values[i].size();
-					}
+					maxValue = (int)jter.value().size();
 				}
 			}
 			inlierScores.insert(iter.key(), maxValue);
@@ -1549,7 +1562,7 @@ void MainWindow::update(const cv::Mat & image)
 
 		if(info.objDetected_.size() > 0 || Settings::getGeneral_sendNoObjDetectedEvents())
 		{
-			Q_EMIT objectsFound(info);
+			Q_EMIT objectsFound(infoPtr);
 		}
 		ui_->label_objectsDetected->setNum(info.objDetected_.size());
 	}
@@ -1636,6 +1649,10 @@ void MainWindow::notifyParametersChanged(const QStringList & paramChanged)
 					  iter->compare(Settings::kGeneral_invertedSearch()) == 0 ||
 					  (iter->compare(Settings::kGeneral_vocabularyIncremental()) == 0 && Settings::getGeneral_invertedSearch()) ||
 					  (iter->compare(Settings::kGeneral_vocabularyFixed()) == 0 && Settings::getGeneral_invertedSearch()) ||
+					  (iter->compare(Settings::kGeneral_stopWordsMaxFrequency()) == 0 && Settings::getGeneral_invertedSearch()) ||
+					  (iter->compare(Settings::kGeneral_globalRetrieval()) == 0 && Settings::getGeneral_invertedSearch()) ||
+					  (iter->compare(Settings::kGeneral_globalRetrievalClusters()) == 0 && Settings::getGeneral_invertedSearch()) ||
+					  (iter->compare(Settings::kGeneral_globalRetrievalDim()) == 0 && Settings::getGeneral_invertedSearch()) ||
 					  (iter->compare(Settings::kGeneral_threads()) == 0 && !Settings::getGeneral_invertedSearch()) )
 			{
 				nearestNeighborParamsChanged = true;
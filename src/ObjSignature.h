@@ -35,6 +35,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QtCore/QDataStream>
 #include <QtCore/QByteArray>
 #include <QtCore/QFileInfo>
+#include <QtCore/QMutex>
 #include <Compression.h>
 
 namespace find_object {
@@ -42,13 +43,17 @@ namespace find_object {
 class ObjSignature {
 public:
 	ObjSignature() :
-		id_(-1)
+		id_(-1),
+		pyramidWinSize_(0),
+		pyramidMaxLevel_(0)
 	{}
 	ObjSignature(int id, const cv::Mat & image, const QString & filePath) :
 		id_(id),
 		image_(image),
 		rect_(0,0,image.cols, image.rows),
-		filePath_(filePath)
+		filePath_(filePath),
+		pyramidWinSize_(0),
+		pyramidMaxLevel_(0)
 	{}
 	virtual ~ObjSignature() {}
 
@@ -59,7 +64,13 @@ public:
 	}
 	void setWords(const QMultiMap<int, int> & words) {words_ = words;}
 	void setId(int id) {id_ = id;}
-	void removeImage() {image_ = cv::Mat();}
+	void removeImage()
+	{
+		image_ = cv::Mat();
+		QMutexLocker lock(&pyramidMutex_);
+		pyramid_.clear();
+		pyramidSize_ = cv::Size();
+	}
 
 	const QRect & rect() const {return rect_;}
 
@@ -70,6 +81,38 @@ public:
 	const cv::Mat & descriptors() const {return descriptors_;}
 	const QMultiMap<int, int> & words() const {return words_;}
 
+	// Optical flow pyramid of the image zero-padded to sceneSize (cv::calcOpticalFlowPyrLK()
+	// requires images of the same size). It is built only when the scene size or
+	// the parameters change. Returns empty if the image is larger than the scene.
+	std::vector<cv::Mat> opticalFlowPyramid(const cv::Size & sceneSize, int winSize, int maxLevel) const
+	{
+		QMutexLocker lock(&pyramidMutex_);
+		if(pyramidSize_ != sceneSize || pyramidWinSize_ != winSize || pyramidMaxLevel_ != maxLevel)
+		{
+			std::vector<cv::Mat> pyramid; // don't overwrite buffers shared with other threads
+			if(!image_.empty() && image_.cols <= sceneSize.width && image_.rows <= sceneSize.height)
+			{
+				cv::Mat gray = image_;
+				if(image_.channels() != 1 || image_.depth() != CV_8U)
+				{
+					cv::cvtColor(image_, gray, cv::COLOR_BGR2GRAY);
+				}
+				cv::Mat padded = gray;
+				if(gray.size() != sceneSize)
+				{
+					padded = cv::Mat::zeros(sceneSize, gray.type());
+					gray.copyTo(padded(cv::Rect(0,0,gray.cols, gray.rows)));
+				}
+				cv::buildOpticalFlowPyramid(padded, pyramid, cv::Size(winSize, winSize), maxLevel);
+			}
+			pyramid_ = pyramid;
+			pyramidSize_ = sceneSize;
+			pyramidWinSize_ = winSize;
+			pyramidMaxLevel_ = maxLevel;
+		}
+		return pyramid_;
+	}
+
 	void save(QDataStream & streamPtr) const
 	{
 		streamPtr << id_;
@@ -195,6 +238,13 @@ private:
 	std::vector<cv::KeyPoint> keypoints_;
 	cv::Mat descriptors_;
 	QMultiMap<int, int> words_; // <word id, keypoint indexes>
+
+	// optical flow cache
+	mutable QMutex pyramidMutex_;
+	mutable std::vector<cv::Mat> pyramid_;
+	mutable cv::Size pyramidSize_;
+	mutable int pyramidWinSize_;
+	mutable int pyramidMaxLevel_;
 };
 
 } // namespace find_object
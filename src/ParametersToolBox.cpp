@@ -218,8 +218,8 @@ void ParametersToolBox::updateParametersVisibility()
 					}
 					else if(objects[i]->objectName().split('/').at(1).contains("Distance_type"))
 					{
-						// don't show distance when bruteforce is selected
-						((QWidget*)objects[i])->setVisible(nnBox->currentIndex() != 6);
+						// don't show distance when bruteforce or vocabulary tree is selected
+						((QWidget*)objects[i])->setVisible(nnBox->currentIndex() != 6 && nnBox->currentIndex() != 7);
 					}
 				}
 			}
@@ -663,7 +663,10 @@ void ParametersToolBox::changeParameter(QObject * sender, int value)
 									  descriptorBox->currentText().compare("LATCH") == 0 ||
 									  descriptorBox->currentText().compare("LUCID") == 0;
 			bool binToFloat = binToFloatCheckbox->isChecked();
-			if(isBinaryDescriptor && !binToFloat && nnBox->currentText().compare("Lsh") != 0 && nnBox->currentText().compare("BruteForce") != 0)
+			if(isBinaryDescriptor && !binToFloat &&
+			   nnBox->currentText().compare("Lsh") != 0 &&
+			   nnBox->currentText().compare("BruteForce") != 0 &&
+			   nnBox->currentText().compare("VocabularyTree") != 0)
 			{
 				QMessageBox::warning(this,
 						tr("Warning"),
@@ -764,7 +767,10 @@ void ParametersToolBox::changeParameter(QObject * sender, int value)
 		{
 			QComboBox * nnBox = (QComboBox*)this->getParameterWidget(Settings::kNearestNeighbor_1Strategy());
 			QComboBox * distBox = (QComboBox*)this->getParameterWidget(Settings::kNearestNeighbor_2Distance_type());
-			if(nnBox->currentText().compare("BruteForce") != 0 && nnBox->currentText().compare("Lsh") != 0 && distBox->currentIndex() > 1)
+			if(nnBox->currentText().compare("BruteForce") != 0 &&
+			   nnBox->currentText().compare("Lsh") != 0 &&
+			   nnBox->currentText().compare("VocabularyTree") != 0 &&
+			   distBox->currentIndex() > 1)
 			{
 				QMessageBox::warning(this,
 									tr("Warning"),
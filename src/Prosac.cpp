@@ -0,0 +1,502 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/utilite/ULogger.h"
+#include "Prosac.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+namespace find_object {
+
+// Squared reprojection error of b relative to a transformed by h (3x3 row-major)
+static double reprojectionError(const double * h, const cv::Point2f & a, const cv::Point2f & b)
+{
+	double w = h[6]*a.x + h[7]*a.y + h[8];
+	if(std::fabs(w) < DBL_EPSILON)
+	{
+		return DBL_MAX;
+	}
+	double x = (h[0]*a.x + h[1]*a.y + h[2])/w - b.x;
+	double y = (h[3]*a.x + h[4]*a.y + h[5])/w - b.y;
+	return x*x + y*y;
+}
+
+static bool collinear(const cv::Point2f & a, const cv::Point2f & b, const cv::Point2f & c)
+{
+	// twice the area of the triangle, in pixels^2
+	return std::fabs((b.x-a.x)*(c.y-a.y) - (b.y-a.y)*(c.x-a.x)) < 1.0f;
+}
+
+// SPRT decision threshold (Chum and Matas, 2008), the time to compute a
+// model is approximated to 200 verifications of a point.
+static double sprtThreshold(double epsilon, double delta)
+{
+	const double modelTime = 200.0;
+	double c = (1.0-delta)*std::log((1.0-delta)/(1.0-epsilon)) + delta*std::log(delta/epsilon);
+	double a = modelTime*c + 1.0;
+	for(int i=0; i<10; ++i)
+	{
+		double next = modelTime*c + 1.0 + std::log(a);
+		if(std::fabs(next - a) < 1e-6)
+		{
+			return next;
+		}
+		a = next;
+	}
+	return a;
+}
+
+Prosac::Prosac(
+		Model model,
+		double reprojThr,
+		int maxIterations,
+		double confidence,
+		bool localOptimization,
+		bool sprt,
+		unsigned int seed) :
+	model_(model),
+	reprojThr_(reprojThr),
+	maxIterations_(maxIterations),
+	confidence_(confidence),
+	localOptimization_(localOptimization),
+	sprt_(sprt),
+	seed_(seed)
+{
+}
+
+int Prosac::sampleSize() const
+{
+	switch(model_)
+	{
+	case kModelSimilarity:
+		return 2;
+	case kModelAffine:
+		return 3;
+	default:
+		return 4;
+	}
+}
+
+cv::Mat Prosac::estimate(
+		const std::vector<cv::Point2f> & src,
+		const std::vector<cv::Point2f> & dst,
+		std::vector<unsigned char> & mask,
+		int * iterations) const
+{
+	UASSERT(src.size() == dst.size());
+	mask.assign(src.size(), 0);
+	if(iterations)
+	{
+		*iterations = 0;
+	}
+
+	int N = (int)src.size();
+	int m = sampleSize();
+	if(N < m)
+	{
+		return cv::Mat();
+	}
+
+	cv::RNG rng(seed_);
+	double thr2 = reprojThr_*reprojThr_;
+
+	// PROSAC growth function
+	double Tn = maxIterations_;
+	for(int i=0; i<m; ++i)
+	{
+		Tn *= double(m-i)/double(N-i);
+	}
+	double TnPrime = 1.0;
+	int n = m;
+
+	// SPRT: points are verified in random order
+	double epsilon = 0.1; // probability that a point is consistent with a good model
+	double delta = 0.05;  // probability that a point is consistent with a bad model
+	double A = sprtThreshold(epsilon, delta);
+	double deltaSum = 0.0;
+	int rejectedModels = 0;
+	std::vector<int> order(N);
+	for(int i=0; i<N; ++i)
+	{
+		order[i] = i;
+	}
+	for(int i=N-1; i>0; --i)
+	{
+		std::swap(order[i], order[rng.uniform(0, i+1)]);
+	}
+
+	cv::Mat bestModel;
+	int bestSupport = 0;
+	int maxIterations = maxIterations_;
+	std::vector<int> sample(m);
+	int t = 0;
+	for(; t<maxIterations; ++t)
+	{
+		// Grow the sampling set of the best correspondences
+		if(t+1 > TnPrime && n < N)
+		{
+			double TnNext = Tn*double(n+1)/double(n+1-m);
+			++n;
+			TnPrime += std::ceil(TnNext - Tn);
+			Tn = TnNext;
+		}
+
+		// The n-th correspondence is always in the sample, the others are
+		// drawn from the n-1 best, until the whole set is sampled uniformly.
+		int randomCount = m;
+		int range = n;
+		if(TnPrime >= t+1)
+		{
+			sample[m-1] = n-1;
+			randomCount = m-1;
+			range = n-1;
+		}
+		for(int i=0; i<randomCount; ++i)
+		{
+			int index;
+			bool duplicate;
+			do
+			{
+				index = rng.uniform(0, range);
+				duplicate = std::find(sample.begin(), sample.begin()+i, index) != sample.begin()+i;
+			}
+			while(duplicate);
+			sample[i] = index;
+		}
+
+		cv::Mat model = fitMinimal(src, dst, sample);
+		if(model.empty())
+		{
+			continue;
+		}
+
+		// Verification
+		int modelSupport = 0;
+		if(sprt_ && delta < epsilon)
+		{
+			const double * h = model.ptr<double>();
+			double lambda = 1.0;
+			bool rejected = false;
+			int tested = 0;
+			for(; tested<N; ++tested)
+			{
+				int index = order[tested];
+				if(reprojectionError(h, src[index], dst[index]) < thr2)
+				{
+					++modelSupport;
+					lambda *= delta/epsilon;
+				}
+				else
+				{
+					lambda *= (1.0-delta)/(1.0-epsilon);
+				}
+				if(lambda > A)
+				{
+					rejected = true;
+					++tested;
+					break;
+				}
+			}
+			if(rejected)
+			{
+				// update the estimate of delta with the rejected models
+				++rejectedModels;
+				deltaSum += double(modelSupport)/double(tested);
+				delta = std::min(std::max(deltaSum/double(rejectedModels), 0.001), 0.5);
+				if(delta < epsilon)
+				{
+					A = sprtThreshold(epsilon, delta);
+				}
+				continue;
+			}
+		}
+		else
+		{
+			modelSupport = support(model, src, dst);
+		}
+
+		if(modelSupport > bestSupport)
+		{
+			bestSupport = modelSupport;
+			bestModel = model;
+			if(localOptimization_)
+			{
+				bestModel = localOptimization(model, src, dst, bestSupport);
+			}
+
+			// update termination criterion and SPRT
+			double w = double(bestSupport)/double(N);
+			epsilon = std::min(std::max(w, 0.001), 0.999);
+			if(delta < epsilon)
+			{
+				A = sprtThreshold(epsilon, delta);
+			}
+			double pNoOutliers = 1.0 - std::pow(w, m);
+			if(pNoOutliers <= DBL_EPSILON)
+			{
+				maxIterations = t+1;
+			}
+			else
+			{
+				double k = std::log(1.0 - confidence_)/std::log(pNoOutliers);
+				if(k < double(maxIterations))
+				{
+					maxIterations = std::max((int)std::ceil(k), t+1);
+				}
+			}
+		}
+	}
+
+	if(iterations)
+	{
+		*iterations = t;
+	}
+
+	if(bestModel.empty())
+	{
+		return cv::Mat();
+	}
+
+	// Final refinement on all inliers
+	std::vector<int> inliers;
+	support(bestModel, src, dst, &inliers);
+	cv::Mat refined = fitLeastSquares(src, dst, inliers);
+	if(!refined.empty())
+	{
+		std::vector<int> refinedInliers;
+		if(support(refined, src, dst, &refinedInliers) >= (int)inliers.size())
+		{
+			bestModel = refined;
+			inliers = refinedInliers;
+		}
+	}
+	for(unsigned int i=0; i<inliers.size(); ++i)
+	{
+		mask[inliers[i]] = 1;
+	}
+	UDEBUG("PROSAC: %d iterations, %d/%d inliers (sampled from %d best, %d models rejected by SPRT)",
+			t, (int)inliers.size(), N, n, rejectedModels);
+	return bestModel;
+}
+
+cv::Mat Prosac::fitMinimal(
+		const std::vector<cv::Point2f> & src,
+		const std::vector<cv::Point2f> & dst,
+		const std::vector<int> & sample) const
+{
+	cv::Point2f a[4];
+	cv::Point2f b[4];
+	for(unsigned int i=0; i<sample.size() && i<4; ++i)
+	{
+		a[i] = src[sample[i]];
+		b[i] = dst[sample[i]];
+	}
+
+	if(model_ == kModelSimilarity)
+	{
+		cv::Point2f da = a[1] - a[0];
+		cv::Point2f db = b[1] - b[0];
+		double d2 = da.dot(da);
+		if(d2 < 1.0 || db.dot(db) < 1.0)
+		{
+			return cv::Mat();
+		}
+		// db = [p -q; q p] da
+		double p = (da.x*db.x + da.y*db.y)/d2;
+		double q = (da.x*db.y - da.y*db.x)/d2;
+		return (cv::Mat_<double>(3,3) <<
+				p, -q, b[0].x - (p*a[0].x - q*a[0].y),
+				q, p, b[0].y - (q*a[0].x + p*a[0].y),
+				0, 0, 1);
+	}
+
+	// reject degenerate samples
+	int m = sampleSize();
+	for(int i=0; i<m; ++i)
+	{
+		for(int j=i+1; j<m; ++j)
+		{
+			for(int k=j+1; k<m; ++k)
+			{
+				if(collinear(a[i], a[j], a[k]) || collinear(b[i], b[j], b[k]))
+				{
+					return cv::Mat();
+				}
+			}
+		}
+	}
+
+	if(model_ == kModelAffine)
+	{
+		cv::Mat H = cv::Mat::eye(3, 3, CV_64FC1);
+		cv::getAffineTransform(a, b).copyTo(H.rowRange(0,2));
+		return H;
+	}
+
+	cv::Mat H = cv::getPerspectiveTransform(a, b);
+	if(H.empty() || cv::countNonZero(H) < 1)
+	{
+		return cv::Mat();
+	}
+	return H;
+}
+
+cv::Mat Prosac::fitLeastSquares(
+		const std::vector<cv::Point2f> & src,
+		const std::vector<cv::Point2f> & dst,
+		const std::vector<int> & indexes) const
+{
+	int n = (int)indexes.size();
+	if(n < sampleSize())
+	{
+		return cv::Mat();
+	}
+
+	if(model_ == kModelHomography)
+	{
+		std::vector<cv::Point2f> a(n);
+		std::vector<cv::Point2f> b(n);
+		for(int i=0; i<n; ++i)
+		{
+			a[i] = src[indexes[i]];
+			b[i] = dst[indexes[i]];
+		}
+		cv::Mat H = cv::findHomography(a, b, 0);
+		if(H.empty() || cv::countNonZero(H) < 1)
+		{
+			return cv::Mat();
+		}
+		return H;
+	}
+
+	// Linear system: affine [x y 1 0 0 0; 0 0 0 x y 1],
+	// similarity [x -y 1 0; y x 0 1] with [p q tx ty]
+	int cols = model_ == kModelAffine?6:4;
+	cv::Mat A = cv::Mat::zeros(2*n, cols, CV_64FC1);
+	cv::Mat B(2*n, 1, CV_64FC1);
+	for(int i=0; i<n; ++i)
+	{
+		const cv::Point2f & a = src[indexes[i]];
+		const cv::Point2f & b = dst[indexes[i]];
+		double * r0 = A.ptr<double>(2*i);
+		double * r1 = A.ptr<double>(2*i+1);
+		if(model_ == kModelAffine)
+		{
+			r0[0] = a.x; r0[1] = a.y; r0[2] = 1.0;
+			r1[3] = a.x; r1[4] = a.y; r1[5] = 1.0;
+		}
+		else
+		{
+			r0[0] = a.x; r0[1] = -a.y; r0[2] = 1.0;
+			r1[0] = a.y; r1[1] = a.x; r1[3] = 1.0;
+		}
+		B.at<double>(2*i) = b.x;
+		B.at<double>(2*i+1) = b.y;
+	}
+	cv::Mat X;
+	if(!cv::solve(A, B, X, cv::DECOMP_CHOLESKY | cv::DECOMP_NORMAL))
+	{
+		return cv::Mat();
+	}
+	const double * x = X.ptr<double>();
+	if(model_ == kModelAffine)
+	{
+		return (cv::Mat_<double>(3,3) <<
+				x[0], x[1], x[2],
+				x[3], x[4], x[5],
+				0, 0, 1);
+	}
+	return (cv::Mat_<double>(3,3) <<
+			x[0], -x[1], x[2],
+			x[1], x[0], x[3],
+			0, 0, 1);
+}
+
+int Prosac::support(
+		const cv::Mat & model,
+		const std::vector<cv::Point2f> & src,
+		const std::vector<cv::Point2f> & dst,
+		std::vector<int> * inliers) const
+{
+	UASSERT(model.rows == 3 && model.cols == 3 && model.type() == CV_64FC1 && model.isContinuous());
+	const double * h = model.ptr<double>();
+	double thr2 = reprojThr_*reprojThr_;
+	int count = 0;
+	if(inliers)
+	{
+		inliers->clear();
+	}
+	for(unsigned int i=0; i<src.size(); ++i)
+	{
+		if(reprojectionError(h, src[i], dst[i]) < thr2)
+		{
+			++count;
+			if(inliers)
+			{
+				inliers->push_back(i);
+			}
+		}
+	}
+	return count;
+}
+
+cv::Mat Prosac::localOptimization(
+		const cv::Mat & model,
+		const std::vector<cv::Point2f> & src,
+		const std::vector<cv::Point2f> & dst,
+		int & bestSupport) const
+{
+	// Iterative least squares on the inliers of the model
+	cv::Mat best = model;
+	std::vector<int> inliers;
+	bestSupport = support(best, src, dst, &inliers);
+	for(int i=0; i<4; ++i)
+	{
+		cv::Mat refined = fitLeastSquares(src, dst, inliers);
+		if(refined.empty())
+		{
+			break;
+		}
+		std::vector<int> refinedInliers;
+		int refinedSupport = support(refined, src, dst, &refinedInliers);
+		if(refinedSupport < bestSupport)
+		{
+			break;
+		}
+		best = refined;
+		inliers.swap(refinedInliers);
+		if(refinedSupport == bestSupport)
+		{
+			break;
+		}
+		bestSupport = refinedSupport;
+	}
+	return best;
+}
+
+} // namespace find_object
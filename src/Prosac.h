@@ -0,0 +1,102 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PROSAC_H_
+#define PROSAC_H_
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace find_object {
+
+// PROSAC robust estimator (Chum and Matas, 2005): minimal samples are drawn
+// from progressively larger sets of the best correspondences, so points must
+// be sorted by quality (best first). Optionally, each new best model is
+// refined by local optimization (LO-RANSAC) and bad models are rejected early
+// with Wald's sequential probability ratio test (SPRT). Results are
+// deterministic for a given seed.
+class Prosac {
+public:
+	enum Model {
+		kModelHomography = 0, // 4 points
+		kModelAffine = 1,     // 3 points
+		kModelSimilarity = 2  // 2 points
+	};
+
+public:
+	Prosac(Model model = kModelHomography,
+			double reprojThr = 3.0,
+			int maxIterations = 2000,
+			double confidence = 0.995,
+			bool localOptimization = true,
+			bool sprt = true,
+			unsigned int seed = 0);
+	virtual ~Prosac() {}
+
+	// Return the 3x3 CV_64FC1 transformation (empty if not found). The
+	// mask is set to 1 for inliers. Number of iterations done is set if not null.
+	cv::Mat estimate(
+			const std::vector<cv::Point2f> & src,
+			const std::vector<cv::Point2f> & dst,
+			std::vector<unsigned char> & mask,
+			int * iterations = 0) const;
+
+	int sampleSize() const;
+
+private:
+	cv::Mat fitMinimal(
+			const std::vector<cv::Point2f> & src,
+			const std::vector<cv::Point2f> & dst,
+			const std::vector<int> & sample) const;
+	cv::Mat fitLeastSquares(
+			const std::vector<cv::Point2f> & src,
+			const std::vector<cv::Point2f> & dst,
+			const std::vector<int> & indexes) const;
+	int support(
+			const cv::Mat & model,
+			const std::vector<cv::Point2f> & src,
+			const std::vector<cv::Point2f> & dst,
+			std::vector<int> * inliers = 0) const;
+	cv::Mat localOptimization(
+			const cv::Mat & model,
+			const std::vector<cv::Point2f> & src,
+			const std::vector<cv::Point2f> & dst,
+			int & bestSupport) const;
+
+private:
+	Model model_;
+	double reprojThr_;
+	int maxIterations_;
+	double confidence_;
+	bool localOptimization_;
+	bool sprt_;
+	unsigned int seed_;
+};
+
+} // namespace find_object
+
+#endif /* PROSAC_H_ */
@@ -0,0 +1,238 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "ReadAhead.h"
+#include "ImageDecoder.h"
+#include "find_object/utilite/ULogger.h"
+#include <QtCore/QMutexLocker>
+#include <QtCore/QRunnable>
+#include <algorithm>
+
+namespace find_object {
+
+class ImageDecodeTask : public QRunnable
+{
+public:
+	ImageDecodeTask(ImagesReadAhead * owner, int index, const std::string & path, bool grayscale, int reduction) :
+		owner_(owner),
+		index_(index),
+		path_(path),
+		grayscale_(grayscale),
+		reduction_(reduction)
+	{}
+	virtual ~ImageDecodeTask() {}
+
+	virtual void run()
+	{
+		cv::Mat image;
+		bool canceled;
+		{
+			QMutexLocker lock(&owner_->mutex_);
+			canceled = owner_->canceled_;
+		}
+		if(!canceled)
+		{
+			image = ImageDecoder::readReduced(path_, grayscale_, reduction_);
+		}
+		owner_->decoded(index_, image);
+	}
+
+private:
+	ImagesReadAhead * owner_;
+	int index_;
+	std::string path_;
+	bool grayscale_;
+	int reduction_;
+};
+
+ImagesReadAhead::ImagesReadAhead(
+		const QList<std::string> & paths,
+		int readAhead,
+		int threads,
+		bool grayscale,
+		const cv::Size & targetSize) :
+	paths_(paths),
+	readAhead_(std::max(readAhead, 1)),
+	grayscale_(grayscale),
+	reduction_(1),
+	index_(0),
+	canceled_(false)
+{
+	pool_.setMaxThreadCount(std::max(threads, 1));
+	if(targetSize.width > 0 && targetSize.height > 0 && paths_.size())
+	{
+		// The first image gives the reduction used to decode the others
+		cv::Mat first = ImageDecoder::readReduced(paths_.front(), grayscale_, 1);
+		reduction_ = ImageDecoder::selectReduction(first.size(), targetSize);
+		images_.insert(0, first);
+	}
+	UDEBUG("images=%d readAhead=%d threads=%d reduction=%d", paths_.size(), readAhead_, pool_.maxThreadCount(), reduction_);
+}
+
+ImagesReadAhead::~ImagesReadAhead()
+{
+	mutex_.lock();
+	canceled_ = true;
+	mutex_.unlock();
+	pool_.waitForDone();
+}
+
+void ImagesReadAhead::schedule(int index)
+{
+	// mutex_ should be locked
+	if(index >= 0 && index < paths_.size() && !images_.contains(index) && !pending_.contains(index))
+	{
+		pending_.insert(index);
+		pool_.start(new ImageDecodeTask(this, index, paths_.at(index), grayscale_, reduction_));
+	}
+}
+
+cv::Mat ImagesReadAhead::take(int index)
+{
+	QMutexLocker lock(&mutex_);
+	if(index < 0 || index >= paths_.size())
+	{
+		return cv::Mat();
+	}
+	index_ = index;
+
+	// Bounded memory: drop images out of the window (seek)
+	for(QMap<int, cv::Mat>::iterator iter=images_.begin(); iter!=images_.end();)
+	{
+		if(iter.key() < index_ || iter.key() > index_+readAhead_)
+		{
+			iter = images_.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	for(int i=index_; i<=index_+readAhead_; ++i)
+	{
+		schedule(i);
+	}
+	while(!images_.contains(index_))
+	{
+		decodedCondition_.wait(&mutex_);
+	}
+	cv::Mat image = images_.take(index_);
+	schedule(index_+readAhead_+1);
+	return image;
+}
+
+void ImagesReadAhead::decoded(int index, const cv::Mat & image)
+{
+	QMutexLocker lock(&mutex_);
+	pending_.remove(index);
+	if(!canceled_ && index >= index_ && index <= index_+readAhead_+1)
+	{
+		if(image.empty())
+		{
+			UWARN("Cannot read image \"%s\"", paths_.at(index).c_str());
+		}
+		images_.insert(index, image);
+	}
+	decodedCondition_.wakeAll();
+}
+
+VideoReadAhead::VideoReadAhead(cv::VideoCapture * capture, int readAhead, int stride) :
+	capture_(capture),
+	readAhead_(std::max(readAhead, 1)),
+	stride_(std::max(stride, 1)),
+	end_(false),
+	stop_(false)
+{
+	UASSERT(capture_ != 0);
+}
+
+VideoReadAhead::~VideoReadAhead()
+{
+	stop();
+}
+
+void VideoReadAhead::stop()
+{
+	mutex_.lock();
+	stop_ = true;
+	notFull_.wakeAll();
+	notEmpty_.wakeAll();
+	mutex_.unlock();
+	this->wait();
+}
+
+cv::Mat VideoReadAhead::take()
+{
+	QMutexLocker lock(&mutex_);
+	while(frames_.empty() && !end_ && !stop_)
+	{
+		notEmpty_.wait(&mutex_);
+	}
+	cv::Mat frame;
+	if(frames_.size())
+	{
+		frame = frames_.takeFirst();
+		notFull_.wakeOne();
+	}
+	return frame;
+}
+
+void VideoReadAhead::run()
+{
+	while(true)
+	{
+		// Frame stride: skipped frames are not decoded
+		bool ok = true;
+		for(int i=1; i<stride_ && ok; ++i)
+		{
+			ok = capture_->grab();
+		}
+		cv::Mat frame;
+		if(!ok || !capture_->read(frame) || frame.empty())
+		{
+			QMutexLocker lock(&mutex_);
+			end_ = true;
+			notEmpty_.wakeAll();
+			break;
+		}
+
+		QMutexLocker lock(&mutex_);
+		while(frames_.size() >= readAhead_ && !stop_)
+		{
+			notFull_.wait(&mutex_);
+		}
+		if(stop_)
+		{
+			break;
+		}
+		frames_.push_back(frame.clone()); // clone required with VideoCapture::read()
+		notEmpty_.wakeOne();
+	}
+}
+
+} // namespace find_object
@@ -0,0 +1,110 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef READAHEAD_H_
+#define READAHEAD_H_
+
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QSet>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <QtCore/QThread>
+#include <QtCore/QThreadPool>
+#include <opencv2/highgui/highgui.hpp>
+#include <string>
+
+namespace find_object {
+
+// Directory of images (Camera/readAhead): the next images are decoded on
+// a thread pool while the current one is processed. Images are returned in
+// the order of the list, at most readAhead images are kept in memory.
+class ImagesReadAhead
+{
+public:
+	ImagesReadAhead(
+			const QList<std::string> & paths,
+			int readAhead,
+			int threads,
+			bool grayscale,
+			const cv::Size & targetSize = cv::Size()); // 0 means full resolution
+	virtual ~ImagesReadAhead();
+
+	// Blocking until the image is decoded
+	cv::Mat take(int index);
+
+private:
+	friend class ImageDecodeTask;
+	void decoded(int index, const cv::Mat & image);
+	void schedule(int index);
+
+private:
+	QList<std::string> paths_;
+	int readAhead_;
+	bool grayscale_;
+	int reduction_;
+	QThreadPool pool_;
+	QMutex mutex_;
+	QWaitCondition decodedCondition_;
+	QMap<int, cv::Mat> images_; // decoded, not taken yet
+	QSet<int> pending_; // scheduled, not decoded yet
+	int index_; // next image taken
+	bool canceled_;
+};
+
+// Video file (Camera/readAhead): frames are decoded in their own thread,
+// at most readAhead frames ahead. Only one frame every stride frames is
+// decoded, the others are skipped with grab().
+class VideoReadAhead : public QThread
+{
+public:
+	VideoReadAhead(cv::VideoCapture * capture, int readAhead, int stride);
+	virtual ~VideoReadAhead();
+
+	// Blocking until a frame is decoded, empty at the end of the video
+	cv::Mat take();
+	void stop();
+	int stride() const {return stride_;}
+
+protected:
+	virtual void run();
+
+private:
+	cv::VideoCapture * capture_;
+	int readAhead_;
+	int stride_;
+	QMutex mutex_;
+	QWaitCondition notFull_;
+	QWaitCondition notEmpty_;
+	QList<cv::Mat> frames_;
+	bool end_;
+	bool stop_;
+};
+
+} // namespace find_object
+
+#endif /* READAHEAD_H_ */
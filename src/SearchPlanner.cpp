@@ -0,0 +1,213 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/utilite/ULogger.h"
+#include "SearchPlanner.h"
+#include <QtCore/QMutexLocker>
+#include <cmath>
+
+namespace find_object {
+
+// Weight of the last measure in moving averages
+static const double kSmoothing = 0.1;
+// Each plan is measured at least this number of times before trusting the model
+static const int kMinSamples = 3;
+// The plan not chosen is measured again every X frames to follow changes
+static const int kExplorationPeriod = 50;
+
+SearchPlanner::SearchPlanner()
+{
+	reset();
+}
+
+void SearchPlanner::reset()
+{
+	QMutexLocker lock(&mutex_);
+	for(int i=0; i<2; ++i)
+	{
+		costPerWork_[i] = 0.0;
+		samples_[i] = 0;
+	}
+	frames_ = 0;
+	sceneDescriptors_ = 0.0f;
+	lastSceneIndex_ = kSceneIndexNN;
+	invertedSearchRecommended_ = -1;
+	for(int i=0; i<2; ++i)
+	{
+		stageCost_[i] = 0.0;
+		stageSamples_[i] = 0;
+	}
+}
+
+double SearchPlanner::work(SceneIndex index, int sceneDescriptors, int objectsDescriptors, int descriptorBytes)
+{
+	double n = double(sceneDescriptors);
+	double m = double(objectsDescriptors);
+	double logN = std::log(n+2.0)/std::log(2.0);
+	if(index == kSceneIndexBruteForce)
+	{
+		// all pairs compared
+		return n * m * double(descriptorBytes);
+	}
+	// index built over the scene, then searched by each object's descriptor
+	return (n + m) * logN * double(descriptorBytes);
+}
+
+SearchPlanner::SceneIndex SearchPlanner::chooseSceneIndex(int sceneDescriptors, int objectsDescriptors, int descriptorBytes, float & estimatedMs)
+{
+	QMutexLocker lock(&mutex_);
+	++frames_;
+	estimatedMs = 0.0f;
+
+	// calibration
+	for(int i=0; i<2; ++i)
+	{
+		if(samples_[i] < kMinSamples)
+		{
+			return (SceneIndex)i;
+		}
+	}
+
+	double costs[2];
+	for(int i=0; i<2; ++i)
+	{
+		costs[i] = costPerWork_[i] * work((SceneIndex)i, sceneDescriptors, objectsDescriptors, descriptorBytes);
+	}
+	SceneIndex best = costs[kSceneIndexBruteForce] < costs[kSceneIndexNN]?kSceneIndexBruteForce:kSceneIndexNN;
+	if(frames_ % kExplorationPeriod == 0)
+	{
+		// exploration, not logged
+		best = best==kSceneIndexNN?kSceneIndexBruteForce:kSceneIndexNN;
+	}
+	else if(best != lastSceneIndex_)
+	{
+		UINFO("Search plan: scene index %s -> %s (scene=%d, objects=%d descriptors, estimated %.2f ms vs %.2f ms)",
+				sceneIndexName(lastSceneIndex_).toStdString().c_str(),
+				sceneIndexName(best).toStdString().c_str(),
+				sceneDescriptors,
+				objectsDescriptors,
+				costs[best],
+				costs[best==kSceneIndexNN?kSceneIndexBruteForce:kSceneIndexNN]);
+		lastSceneIndex_ = best;
+	}
+	estimatedMs = (float)costs[best];
+	return best;
+}
+
+void SearchPlanner::addSceneIndexCost(SceneIndex index, int sceneDescriptors, int objectsDescriptors, int descriptorBytes, float ms)
+{
+	double w = work(index, sceneDescriptors, objectsDescriptors, descriptorBytes);
+	if(w <= 0.0)
+	{
+		return;
+	}
+	QMutexLocker lock(&mutex_);
+	double cost = double(ms) / w;
+	if(samples_[index] == 0)
+	{
+		costPerWork_[index] = cost;
+	}
+	else
+	{
+		costPerWork_[index] += kSmoothing * (cost - costPerWork_[index]);
+	}
+	++samples_[index];
+}
+
+void SearchPlanner::addScene(int sceneDescriptors)
+{
+	QMutexLocker lock(&mutex_);
+	if(sceneDescriptors_ == 0.0f)
+	{
+		sceneDescriptors_ = float(sceneDescriptors);
+	}
+	else
+	{
+		sceneDescriptors_ += float(kSmoothing) * (float(sceneDescriptors) - sceneDescriptors_);
+	}
+}
+
+int SearchPlanner::sceneDescriptors() const
+{
+	QMutexLocker lock(&mutex_);
+	return int(sceneDescriptors_+0.5f);
+}
+
+void SearchPlanner::addStageCost(Stage stage, int units, float ms)
+{
+	if(units <= 0)
+	{
+		return;
+	}
+	QMutexLocker lock(&mutex_);
+	double cost = double(ms) / double(units);
+	if(stageSamples_[stage] == 0)
+	{
+		stageCost_[stage] = cost;
+	}
+	else
+	{
+		stageCost_[stage] += kSmoothing * (cost - stageCost_[stage]);
+	}
+	++stageSamples_[stage];
+}
+
+float SearchPlanner::stageCost(Stage stage) const
+{
+	QMutexLocker lock(&mutex_);
+	return (float)stageCost_[stage];
+}
+
+bool SearchPlanner::isInvertedSearchRecommended(int vocabularySize, int objectsDescriptors, float & invertedCost, float & directCost)
+{
+	int n = this->sceneDescriptors();
+	if(n == 0)
+	{
+		n = 1000; // no scene seen yet
+	}
+	// inverted: each scene descriptor searched in the vocabulary (built once)
+	invertedCost = float(double(n) * std::log(double(vocabularySize)+2.0)/std::log(2.0));
+	// direct: index built over the scene on each frame, then searched by each object's descriptor
+	directCost = float(work(kSceneIndexNN, n, objectsDescriptors, 1));
+	bool inverted = invertedCost <= directCost;
+	QMutexLocker lock(&mutex_);
+	invertedSearchRecommended_ = inverted?1:0;
+	return inverted;
+}
+
+int SearchPlanner::lastInvertedSearchRecommendation() const
+{
+	QMutexLocker lock(&mutex_);
+	return invertedSearchRecommended_;
+}
+
+QString SearchPlanner::sceneIndexName(SceneIndex index)
+{
+	return index == kSceneIndexBruteForce?"BruteForce":"NearestNeighbor";
+}
+
+} // namespace find_object
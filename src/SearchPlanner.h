@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SEARCHPLANNER_H_
+#define SEARCHPLANNER_H_
+
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+namespace find_object {
+
+// Runtime cost model choosing how descriptors are matched, calibrated
+// from the measured indexing and matching times of previous detections.
+class SearchPlanner {
+public:
+	enum SceneIndex{
+		kSceneIndexNN,         // nearest neighbor index built over the scene (NearestNeighbor/1Strategy)
+		kSceneIndexBruteForce  // no index, brute force matching
+	};
+	enum Stage{
+		kStageMatching,     // ms per scene descriptor
+		kStageVerification  // ms per batch of homography threads
+	};
+
+public:
+	SearchPlanner();
+	virtual ~SearchPlanner() {}
+
+	void reset();
+
+	// Direct search (not inverted): choose the index built over the scene
+	SceneIndex chooseSceneIndex(int sceneDescriptors, int objectsDescriptors, int descriptorBytes, float & estimatedMs);
+	void addSceneIndexCost(SceneIndex index, int sceneDescriptors, int objectsDescriptors, int descriptorBytes, float ms);
+
+	// Typical number of scene descriptors (moving average)
+	void addScene(int sceneDescriptors);
+	int sceneDescriptors() const;
+
+	// Relative cost of matching one frame with the inverted search (scene to vocabulary) and
+	// with the direct search (objects to scene), for the search direction recommendation
+	bool isInvertedSearchRecommended(int vocabularySize, int objectsDescriptors, float & invertedCost, float & directCost);
+	int lastInvertedSearchRecommendation() const; // -1 if unknown
+
+	// Measured cost of the detection stages, for deadline-aware detection
+	void addStageCost(Stage stage, int units, float ms);
+	float stageCost(Stage stage) const; // 0 if unknown
+
+	static QString sceneIndexName(SceneIndex index);
+
+private:
+	static double work(SceneIndex index, int sceneDescriptors, int objectsDescriptors, int descriptorBytes);
+
+private:
+	mutable QMutex mutex_;
+	double costPerWork_[2]; // ms per work unit, exponential moving average
+	int samples_[2];
+	int frames_;
+	float sceneDescriptors_;
+	SceneIndex lastSceneIndex_;
+	int invertedSearchRecommended_;
+	double stageCost_[2]; // ms per unit, exponential moving average
+	int stageSamples_[2];
+};
+
+} // namespace find_object
+
+#endif /* SEARCHPLANNER_H_ */
@@ -32,8 +32,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QtCore/QSettings>
 #include <QtCore/QStringList>
 #include <QtCore/QDir>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
 #include <stdio.h>
+#include <algorithm>
+#include <cmath>
 #include <opencv2/calib3d/calib3d.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/opencv_modules.hpp>
 
 #if CV_MAJOR_VERSION < 3
@@ -617,6 +622,322 @@ private:
 #endif
 };
 
+// Detector wrapper adjusting its threshold frame to frame so that the number
+// of raw keypoints stays near a target. Fast and AGAST are run tile by tile,
+// each tile having its own threshold. BRISK and SURF are multi-scale, so a
+// single threshold is used for the whole image and the detector is re-created
+// when it changes. Thresholds are kept per image size, so objects, affine
+// warps and scenes don't pull them against each other.
+class AdaptiveFeature2D : public Feature2D
+{
+public:
+	enum Type {kFast, kAGAST, kBRISK, kSURF};
+
+	AdaptiveFeature2D(Type type, double threshold, bool nonmaxSuppression = true) :
+		type_(type),
+		threshold_(threshold),
+		nonmaxSuppression_(nonmaxSuppression),
+		tiles_(type==kFast || type==kAGAST?std::max(1, Settings::getFeature2D_3AdaptiveThresholdTiles()):1),
+		target_(Settings::getFeature2D_3AdaptiveThresholdTarget())
+	{
+		if(target_ <= 0)
+		{
+			target_ = 2*Settings::getFeature2D_3MaxFeatures();
+		}
+		if(target_ <= 0)
+		{
+			UWARN("Adaptive threshold is enabled but there is no target (\"%s\" and \"%s\" are both 0), "
+				  "the threshold will not be adapted.",
+				  Settings::kFeature2D_3AdaptiveThresholdTarget().toStdString().c_str(),
+				  Settings::kFeature2D_3MaxFeatures().toStdString().c_str());
+		}
+		UDEBUG("type=%d threshold=%f target=%d tiles=%d", (int)type_, threshold_, target_, tiles_);
+	}
+	virtual ~AdaptiveFeature2D() {}
+
+	virtual void detect(const cv::Mat & image,
+			std::vector<cv::KeyPoint> & keypoints,
+			const cv::Mat & mask = cv::Mat())
+	{
+		cv::Mat descriptors;
+		this->detectImpl(image, keypoints, descriptors, mask, false);
+	}
+	virtual void compute( const cv::Mat& image,
+		std::vector<cv::KeyPoint>& keypoints,
+		cv::Mat& descriptors)
+	{
+		cv::Ptr<cv::Feature2D> detector = type_==kBRISK || type_==kSURF?createDetector(threshold_):cv::Ptr<cv::Feature2D>();
+		if(!detector.empty())
+		{
+			detector->compute(image, keypoints, descriptors);
+		}
+		else
+		{
+			UERROR("AdaptiveFeature2D:compute() Should not be used with Fast/AGAST!");
+		}
+	}
+	virtual void detectAndCompute( const cv::Mat& image,
+		std::vector<cv::KeyPoint>& keypoints,
+		cv::Mat& descriptors,
+		const cv::Mat & mask = cv::Mat())
+	{
+		if(type_==kBRISK || type_==kSURF)
+		{
+			this->detectImpl(image, keypoints, descriptors, mask, true);
+		}
+		else
+		{
+			UERROR("AdaptiveFeature2D:detectAndCompute() Should not be used with Fast/AGAST!");
+		}
+	}
+
+private:
+	struct State
+	{
+		std::vector<double> thresholds;
+		cv::Ptr<cv::Feature2D> detector; // BRISK/SURF, created with thresholds[0]
+	};
+
+	void detectImpl(const cv::Mat & image,
+			std::vector<cv::KeyPoint> & keypoints,
+			cv::Mat & descriptors,
+			const cv::Mat & mask,
+			bool computeDescriptors)
+	{
+		keypoints.clear();
+		descriptors = cv::Mat();
+		if(image.empty())
+		{
+			return;
+		}
+		QPair<int, int> key(image.cols, image.rows);
+		int tilesCount = tiles_*tiles_;
+
+		std::vector<double> thresholds;
+		cv::Ptr<cv::Feature2D> detector;
+		mutex_.lock();
+		if(!states_.contains(key) && states_.size() >= kMaxStates)
+		{
+			// Many image sizes seen (e.g. objects), restart from scratch
+			states_.clear();
+		}
+		State & state = states_[key];
+		if(state.thresholds.empty())
+		{
+			state.thresholds.resize(tilesCount, threshold_);
+			if(type_==kBRISK || type_==kSURF)
+			{
+				state.detector = createDetector(threshold_);
+			}
+		}
+		thresholds = state.thresholds;
+		detector = state.detector;
+		mutex_.unlock();
+
+		std::vector<int> counts(tilesCount, -1); // -1: tile not evaluated
+		std::vector<double> coverages(tilesCount, 1.0); // ratio of the tile inside the mask
+		if(type_==kBRISK || type_==kSURF)
+		{
+			UASSERT(!detector.empty());
+			if(computeDescriptors)
+			{
+#if CV_MAJOR_VERSION < 3
+				(*detector)(image, mask, keypoints, descriptors);
+#else
+				detector->detectAndCompute(image, mask, keypoints, descriptors);
+#endif
+			}
+			else
+			{
+				detector->detect(image, keypoints, mask);
+			}
+			counts[0] = (int)keypoints.size();
+			if(!mask.empty())
+			{
+				coverages[0] = double(cv::countNonZero(mask))/double(mask.total());
+			}
+		}
+		else
+		{
+			cv::Mat gray = image;
+			if(image.channels() != 1)
+			{
+				cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+			}
+			// border so that corners and non-maximum suppression near
+			// the tile limits are the same than on the whole image
+			const int border = 4;
+			for(int i=0; i<tiles_; ++i)
+			{
+				for(int j=0; j<tiles_; ++j)
+				{
+					cv::Rect tile(
+							j*gray.cols/tiles_,
+							i*gray.rows/tiles_,
+							(j+1)*gray.cols/tiles_ - j*gray.cols/tiles_,
+							(i+1)*gray.rows/tiles_ - i*gray.rows/tiles_);
+					if(tile.width <= 0 || tile.height <= 0)
+					{
+						continue;
+					}
+					if(!mask.empty())
+					{
+						int inside = cv::countNonZero(mask(tile));
+						if(inside == 0)
+						{
+							continue;
+						}
+						coverages[i*tiles_+j] = double(inside)/double(tile.area());
+					}
+					cv::Rect roi(tile.x-border, tile.y-border, tile.width+2*border, tile.height+2*border);
+					roi &= cv::Rect(0, 0, gray.cols, gray.rows);
+
+					std::vector<cv::KeyPoint> tileKeypoints;
+					int threshold = std::max(1, int(thresholds[i*tiles_+j]+0.5));
+					if(type_ == kFast)
+					{
+						cv::FAST(gray(roi), tileKeypoints, threshold, nonmaxSuppression_);
+					}
+#if CV_MAJOR_VERSION >= 3
+					else
+					{
+						cv::AGAST(gray(roi), tileKeypoints, threshold, nonmaxSuppression_);
+					}
+#endif
+					int count = 0;
+					for(unsigned int k=0; k<tileKeypoints.size(); ++k)
+					{
+						cv::KeyPoint kpt = tileKeypoints[k];
+						kpt.pt.x += roi.x;
+						kpt.pt.y += roi.y;
+						if(kpt.pt.x >= tile.x && kpt.pt.x < tile.x+tile.width &&
+						   kpt.pt.y >= tile.y && kpt.pt.y < tile.y+tile.height &&
+						   (mask.empty() || mask.at<unsigned char>(int(kpt.pt.y), int(kpt.pt.x)) != 0))
+						{
+							keypoints.push_back(kpt);
+							++count;
+						}
+					}
+					counts[i*tiles_+j] = count;
+				}
+			}
+		}
+
+		if(target_ > 0)
+		{
+			double tileTarget = double(target_)/double(tilesCount);
+			std::vector<double> newThresholds = thresholds;
+			bool changed = false;
+			for(int i=0; i<tilesCount; ++i)
+			{
+				// The target is scaled by the area detected (e.g. changed blocks with
+				// General/incrementalExtraction), areas too small to be representative
+				// don't change the threshold.
+				if(counts[i] >= 0 && coverages[i] >= 0.25)
+				{
+					newThresholds[i] = adaptThreshold(thresholds[i], counts[i], tileTarget*coverages[i]);
+					changed = changed || newThresholds[i] != thresholds[i];
+				}
+			}
+			if(changed)
+			{
+				cv::Ptr<cv::Feature2D> newDetector;
+				if(type_==kBRISK || type_==kSURF)
+				{
+					newDetector = createDetector(newThresholds[0]);
+				}
+				QMutexLocker lock(&mutex_);
+				State & s = states_[key];
+				s.thresholds = newThresholds;
+				if(!newDetector.empty())
+				{
+					s.detector = newDetector;
+				}
+			}
+			UDEBUG("size=%dx%d keypoints=%d target=%d threshold[0]=%f->%f",
+					image.cols, image.rows, (int)keypoints.size(), target_, thresholds[0], newThresholds[0]);
+		}
+	}
+
+	// Multiplicative step toward the target count, limited to x0.5..x2 per
+	// frame with a dead band around the target to avoid oscillations.
+	double adaptThreshold(double threshold, int count, double target) const
+	{
+		double ratio = double(count)/target;
+		if(ratio > 0.8 && ratio < 1.25)
+		{
+			return threshold;
+		}
+		double factor = ratio>0.0?std::max(0.5, std::min(2.0, std::sqrt(ratio))):0.5;
+		double newThreshold = threshold*factor;
+		if(type_ != kSURF)
+		{
+			// integer thresholds: move at least by one
+			int t = int(newThreshold+0.5);
+			if(t == int(threshold+0.5))
+			{
+				t += ratio>1.0?1:-1;
+			}
+			newThreshold = std::max(1, std::min(255, t));
+		}
+		else
+		{
+			newThreshold = std::max(1.0, newThreshold);
+		}
+		return newThreshold;
+	}
+
+	cv::Ptr<cv::Feature2D> createDetector(double threshold) const
+	{
+		cv::Ptr<cv::Feature2D> detector;
+		if(type_ == kBRISK)
+		{
+#if CV_MAJOR_VERSION < 3
+			detector = cv::Ptr<cv::Feature2D>(new cv::BRISK(
+					int(threshold+0.5),
+					Settings::getFeature2D_BRISK_octaves(),
+					Settings::getFeature2D_BRISK_patternScale()));
+#else
+			detector = cv::BRISK::create(
+					int(threshold+0.5),
+					Settings::getFeature2D_BRISK_octaves(),
+					Settings::getFeature2D_BRISK_patternScale());
+#endif
+		}
+#if FINDOBJECT_NONFREE == 1
+		else if(type_ == kSURF)
+		{
+#if CV_MAJOR_VERSION < 3
+			detector = cv::Ptr<cv::Feature2D>(new cv::SURF(
+					threshold,
+					Settings::getFeature2D_SURF_nOctaves(),
+					Settings::getFeature2D_SURF_nOctaveLayers(),
+					Settings::getFeature2D_SURF_extended(),
+					Settings::getFeature2D_SURF_upright()));
+#else
+			detector = cv::xfeatures2d::SURF::create(
+					threshold,
+					Settings::getFeature2D_SURF_nOctaves(),
+					Settings::getFeature2D_SURF_nOctaveLayers(),
+					Settings::getFeature2D_SURF_extended(),
+					Settings::getFeature2D_SURF_upright());
+#endif
+		}
+#endif
+		return detector;
+	}
+
+private:
+	static const int kMaxStates = 64;
+	Type type_;
+	double threshold_;
+	bool nonmaxSuppression_;
+	int tiles_;
+	int target_;
+	QMutex mutex_;
+	QMap<QPair<int, int>, State> states_;
+};
+
 Feature2D * Settings::createKeypointDetector()
 {
 	Feature2D * feature2D = 0;
@@ -703,6 +1024,14 @@ Feature2D * Settings::createKeypointDetector()
 								getFeature2D_Fast_nonmaxSuppression());
 						UDEBUG("type=%s GPU", strategies.at(index).toStdString().c_str());
 					}
+					else if(getFeature2D_3AdaptiveThreshold())
+					{
+						feature2D = new AdaptiveFeature2D(
+								AdaptiveFeature2D::kFast,
+								getFeature2D_Fast_threshold(),
+								getFeature2D_Fast_nonmaxSuppression());
+						UDEBUG("type=%s (adaptive threshold)", strategies.at(index).toStdString().c_str());
+					}
 					else
 					{
 #if CV_MAJOR_VERSION < 3
@@ -722,9 +1051,19 @@ Feature2D * Settings::createKeypointDetector()
 #if CV_MAJOR_VERSION < 3
 					UWARN("Find-Object is not built with OpenCV 3 so AGAST cannot be used!");
 #else
-					feature2D = new Feature2D(cv::AgastFeatureDetector::create(
-							getFeature2D_AGAST_threshold(),
-							getFeature2D_AGAST_nonmaxSuppression()));
+					if(getFeature2D_3AdaptiveThreshold())
+					{
+						feature2D = new AdaptiveFeature2D(
+								AdaptiveFeature2D::kAGAST,
+								getFeature2D_AGAST_threshold(),
+								getFeature2D_AGAST_nonmaxSuppression());
+					}
+					else
+					{
+						feature2D = new Feature2D(cv::AgastFeatureDetector::create(
+								getFeature2D_AGAST_threshold(),
+								getFeature2D_AGAST_nonmaxSuppression()));
+					}
 #endif
 					UDEBUG("type=%s", strategies.at(index).toStdString().c_str());
 				}
@@ -849,17 +1188,24 @@ Feature2D * Settings::createKeypointDetector()
 				}
 				else if(strategies.at(index).compare("BRISK") == 0)
 				{
+					if(getFeature2D_3AdaptiveThreshold())
+					{
+						feature2D = new AdaptiveFeature2D(AdaptiveFeature2D::kBRISK, getFeature2D_BRISK_thresh());
+					}
+					else
+					{
 #if CV_MAJOR_VERSION < 3
-					feature2D = new Feature2D(cv::Ptr<cv::Feature2D>(new cv::BRISK(
-							getFeature2D_BRISK_thresh(),
-							getFeature2D_BRISK_octaves(),
-							getFeature2D_BRISK_patternScale())));
+						feature2D = new Feature2D(cv::Ptr<cv::Feature2D>(new cv::BRISK(
+								getFeature2D_BRISK_thresh(),
+								getFeature2D_BRISK_octaves(),
+								getFeature2D_BRISK_patternScale())));
 #else
-					feature2D = new Feature2D(cv::BRISK::create(
-							getFeature2D_BRISK_thresh(),
-							getFeature2D_BRISK_octaves(),
-							getFeature2D_BRISK_patternScale()));
+						feature2D = new Feature2D(cv::BRISK::create(
+								getFeature2D_BRISK_thresh(),
+								getFeature2D_BRISK_octaves(),
+								getFeature2D_BRISK_patternScale()));
 #endif
+					}
 					UDEBUG("type=%s", strategies.at(index).toStdString().c_str());
 				}
 				else if(strategies.at(index).compare("KAZE") == 0)
@@ -926,6 +1272,11 @@ Feature2D * Settings::createKeypointDetector()
 								getFeature2D_SURF_upright());
 						UDEBUG("type=%s (GPU)", strategies.at(index).toStdString().c_str());
 					}
+					else if(getFeature2D_3AdaptiveThreshold())
+					{
+						feature2D = new AdaptiveFeature2D(AdaptiveFeature2D::kSURF, getFeature2D_SURF_hessianThreshold());
+						UDEBUG("type=%s (adaptive threshold)", strategies.at(index).toStdString().c_str());
+					}
 					else
 					{
 #if CV_MAJOR_VERSION < 3
@@ -1269,6 +1620,27 @@ bool Settings::isBruteForceNearestNeighbor()
 	return bruteForce;
 }
 
+bool Settings::isVocabularyTreeNearestNeighbor()
+{
+	bool vocabularyTree = false;
+	QString str = getNearestNeighbor_1Strategy();
+	QStringList split = str.split(':');
+	if(split.size()==2)
+	{
+		bool ok = false;
+		int index = split.first().toInt(&ok);
+		if(ok)
+		{
+			QStringList strategies = split.last().split(';');
+			if(strategies.size() >= 8 && index == 7)
+			{
+				vocabularyTree = true;
+			}
+		}
+	}
+	return vocabularyTree;
+}
+
 cv::flann::IndexParams * Settings::createFlannIndexParams()
 {
 	cv::flann::IndexParams * params = 0;
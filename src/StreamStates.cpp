@@ -0,0 +1,98 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "StreamStates.h"
+#include "IncrementalFeatures.h"
+#include "FrameGate.h"
+#include <QtCore/QMutexLocker>
+
+namespace find_object {
+
+StreamStates::StreamStates()
+{
+}
+
+StreamStates::~StreamStates()
+{
+	qDeleteAll(incrementalFeatures_);
+	qDeleteAll(frameGates_);
+}
+
+void StreamStates::resetIncrementalFeatures()
+{
+	QMutexLocker lock(&mutex_);
+	for(QMap<int, IncrementalFeatures*>::iterator iter=incrementalFeatures_.begin(); iter!=incrementalFeatures_.end(); ++iter)
+	{
+		iter.value()->reset();
+	}
+}
+
+void StreamStates::resetFrameGates()
+{
+	QMutexLocker lock(&mutex_);
+	for(QMap<int, FrameGate*>::iterator iter=frameGates_.begin(); iter!=frameGates_.end(); ++iter)
+	{
+		iter.value()->reset();
+	}
+}
+
+void StreamStates::reset(int streamId)
+{
+	QMutexLocker lock(&mutex_);
+	if(incrementalFeatures_.contains(streamId))
+	{
+		incrementalFeatures_.value(streamId)->reset();
+	}
+	if(frameGates_.contains(streamId))
+	{
+		frameGates_.value(streamId)->reset();
+	}
+}
+
+IncrementalFeatures * StreamStates::incrementalFeatures(int streamId)
+{
+	QMutexLocker lock(&mutex_);
+	QMap<int, IncrementalFeatures*>::iterator iter = incrementalFeatures_.find(streamId);
+	if(iter == incrementalFeatures_.end())
+	{
+		iter = incrementalFeatures_.insert(streamId, new IncrementalFeatures());
+	}
+	return iter.value();
+}
+
+FrameGate * StreamStates::frameGate(int streamId)
+{
+	QMutexLocker lock(&mutex_);
+	QMap<int, FrameGate*>::iterator iter = frameGates_.find(streamId);
+	if(iter == frameGates_.end())
+	{
+		iter = frameGates_.insert(streamId, new FrameGate());
+	}
+	return iter.value();
+}
+
+} // namespace find_object
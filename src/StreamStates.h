@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef STREAMSTATES_H_
+#define STREAMSTATES_H_
+
+#include <QtCore/QMutex>
+#include <QtCore/QMap>
+
+namespace find_object {
+
+class IncrementalFeatures;
+class FrameGate;
+
+// Frame gate and incremental extraction references of each scene
+// stream (DetectionInfo::streamId_), so that frames of different TCP
+// cameras are never compared to each other. The states are created on
+// the first frame of a stream and kept until destruction. Stream IDs
+// are reused by the camera server, the states of an ID must be reset
+// when a new client gets it. Thread-safe.
+class StreamStates {
+public:
+	StreamStates();
+	virtual ~StreamStates();
+
+	void resetIncrementalFeatures();
+	void resetFrameGates();
+	void reset(int streamId);
+
+	IncrementalFeatures * incrementalFeatures(int streamId);
+	FrameGate * frameGate(int streamId);
+
+private:
+	QMutex mutex_;
+	QMap<int, IncrementalFeatures*> incrementalFeatures_;
+	QMap<int, FrameGate*> frameGates_;
+};
+
+} // namespace find_object
+
+#endif /* STREAMSTATES_H_ */
@@ -25,7 +25,9 @@ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
 SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 #include "find_object/TcpServer.h"
+#include "find_object/DetectionCache.h"
 #include "find_object/utilite/ULogger.h"
+#include "ImageDecoder.h"
 
 #include <QtNetwork/QNetworkInterface>
 #include <QtNetwork/QTcpSocket>
@@ -35,7 +37,9 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 namespace find_object {
 
 TcpServer::TcpServer(quint16 port, QObject * parent) :
-	QTcpServer(parent)
+	QTcpServer(parent),
+	cache_(0),
+	reduction_(1)
 {
 	if (!this->listen(QHostAddress::Any, port))
 	{
@@ -75,7 +79,59 @@ quint16 TcpServer::getPort() const
 	return this->serverPort();
 }
 
+void TcpServer::setDecodeReduction(int reduction)
+{
+	if(reduction != 1 && reduction != 2 && reduction != 4 && reduction != 8)
+	{
+		UWARN("Decode reduction should be 1, 2, 4 or 8 (%d), 1 is used.", reduction);
+		reduction = 1;
+	}
+	reduction_ = reduction;
+}
+
+// Detection done on a reduced image, scene coordinates are scaled back to the image received
+static DetectionInfo scaleDetectionInfo(const DetectionInfo & info, float scale)
+{
+	DetectionInfo scaled = info;
+	QTransform scaleTransform = QTransform::fromScale(scale, scale);
+	for(QMultiMap<int, QTransform>::iterator iter=scaled.objDetected_.begin(); iter!=scaled.objDetected_.end(); ++iter)
+	{
+		iter.value() = iter.value() * scaleTransform;
+	}
+	for(unsigned int i=0; i<scaled.sceneKeypoints_.size(); ++i)
+	{
+		scaled.sceneKeypoints_[i].pt *= scale;
+		scaled.sceneKeypoints_[i].size *= scale;
+	}
+	return scaled;
+}
+
 void TcpServer::publishDetectionInfo(const DetectionInfo & info)
+{
+	if(pendingDetections_.size())
+	{
+		PendingDetection pending = pendingDetections_.takeFirst();
+		DetectionInfo scaled = pending.reduction>1?scaleDetectionInfo(info, float(pending.reduction)):info;
+		if(cache_ && !pending.hash.isEmpty())
+		{
+			cache_->insert(pending.hash, pending.version, scaled);
+		}
+		sendDetectionInfo(scaled);
+
+		// cached detections requested after this one, in order
+		while(pendingDetections_.size() && pendingDetections_.front().resolved)
+		{
+			sendDetectionInfo(pendingDetections_.front().info);
+			pendingDetections_.pop_front();
+		}
+	}
+	else
+	{
+		sendDetectionInfo(info);
+	}
+}
+
+void TcpServer::sendDetectionInfo(const DetectionInfo & info)
 {
 	QList<QTcpSocket*> clients = this->findChildren<QTcpSocket*>();
 	if(clients.size())
@@ -98,6 +154,14 @@ void TcpServer::publishDetectionInfo(const DetectionInfo & info)
 	}
 }
 
+void TcpServer::publishDetectionInfo(const DetectionInfoPtr & info)
+{
+	if(info)
+	{
+		publishDetectionInfo(*info);
+	}
+}
+
 void TcpServer::addClient()
 {
 	while(this->hasPendingConnections())
@@ -160,11 +224,61 @@ void TcpServer::readReceivedData()
 	else if(serviceType == kDetectObject)
 	{
 		std::vector<unsigned char> buf(blockSizes_[client->socketDescriptor()]);
-		in.readRawData((char*)buf.data(), blockSizes_[client->socketDescriptor()]-sizeof(quint32));
-		cv::Mat image = cv::imdecode(buf, cv::IMREAD_UNCHANGED);
+		int dataSize = in.readRawData((char*)buf.data(), blockSizes_[client->socketDescriptor()]-sizeof(quint32));
 
-		UINFO("TCP service: Detect object");
-		Q_EMIT detectObject(image);
+		// requests still buffered, estimated with the size of this one
+		qint64 requestSize = qint64(blockSizes_[client->socketDescriptor()] + sizeof(quint64));
+		qint64 bytesBuffered = 0;
+		QList<QTcpSocket*> clients = this->findChildren<QTcpSocket*>();
+		for(QList<QTcpSocket*>::iterator iter = clients.begin(); iter!=clients.end(); ++iter)
+		{
+			bytesBuffered += (*iter)->bytesAvailable();
+		}
+		Q_EMIT pendingRequests(int(bytesBuffered / requestSize));
+
+		DetectionInfo cachedInfo;
+		QByteArray hash;
+		if(cache_)
+		{
+			hash = DetectionCache::hash((const char*)buf.data(), dataSize>0?dataSize:0);
+			if(cache_->get(hash, cachedInfo))
+			{
+				UINFO("TCP service: Detect object (cached, hit rate=%.0f%%, hits=%d misses=%d)",
+						cache_->hitRate()*100.0f, cache_->hits(), cache_->misses());
+				if(pendingDetections_.size())
+				{
+					// sent after the detections requested before it
+					PendingDetection pending(hash, cache_->version(), reduction_);
+					pending.resolved = true;
+					pending.info = cachedInfo;
+					pendingDetections_.push_back(pending);
+				}
+				else
+				{
+					sendDetectionInfo(cachedInfo);
+				}
+			}
+			else
+			{
+				UINFO("TCP service: Detect object (not cached, hit rate=%.0f%%, hits=%d misses=%d)",
+						cache_->hitRate()*100.0f, cache_->hits(), cache_->misses());
+				pendingDetections_.push_back(PendingDetection(hash, cache_->version(), reduction_));
+				Q_EMIT detectObject(ImageDecoder::decodeReduced(buf, true, reduction_));
+			}
+		}
+		else if(reduction_ > 1)
+		{
+			UINFO("TCP service: Detect object (decoded at 1/%d)", reduction_);
+			pendingDetections_.push_back(PendingDetection(QByteArray(), 0, reduction_));
+			Q_EMIT detectObject(ImageDecoder::decodeReduced(buf, true, reduction_));
+		}
+		else
+		{
+			cv::Mat image = cv::imdecode(buf, cv::IMREAD_UNCHANGED);
+
+			UINFO("TCP service: Detect object");
+			Q_EMIT detectObject(image);
+		}
 	}
 	else
 	{
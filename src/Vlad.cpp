@@ -0,0 +1,223 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/utilite/ULogger.h"
+#include "Vlad.h"
+
+namespace find_object {
+
+Vlad::Vlad() :
+	descriptorsType_(-1),
+	descriptorsDim_(0)
+{
+}
+
+Vlad::~Vlad()
+{
+}
+
+void Vlad::clear()
+{
+	centers_ = cv::Mat();
+	mean_ = cv::Mat();
+	eigenvectors_ = cv::Mat();
+	descriptorsType_ = -1;
+	descriptorsDim_ = 0;
+}
+
+bool Vlad::train(const std::vector<cv::Mat> & descriptors, int clusters, int dim)
+{
+	clear();
+
+	// Limit memory used for k-means and PCA on large catalogs
+	const int maxSamples = 100000;
+	const int maxPcaSamples = 10000;
+
+	int total = 0;
+	int objects = 0;
+	int type = -1;
+	int cols = 0;
+	for(unsigned int i=0; i<descriptors.size(); ++i)
+	{
+		if(!descriptors[i].empty())
+		{
+			if(type >= 0 && (descriptors[i].type() != type || descriptors[i].cols != cols))
+			{
+				UERROR("Descriptors of the objects are not all the same type/size! Cannot train the VLAD codebook.");
+				return false;
+			}
+			type = descriptors[i].type();
+			cols = descriptors[i].cols;
+			total += descriptors[i].rows;
+			++objects;
+		}
+	}
+
+	if(clusters <= 0 || total < clusters)
+	{
+		UWARN("Not enough descriptors (%d) to train a VLAD codebook of %d clusters.", total, clusters);
+		return false;
+	}
+
+	// Sample the descriptors uniformly
+	int step = total > maxSamples?total/maxSamples+1:1;
+	cv::Mat samples;
+	int index = 0;
+	for(unsigned int i=0; i<descriptors.size(); ++i)
+	{
+		if(!descriptors[i].empty())
+		{
+			cv::Mat data = toFloat(descriptors[i]);
+			for(int j=0; j<data.rows; ++j)
+			{
+				if(index++ % step == 0)
+				{
+					samples.push_back(data.row(j));
+				}
+			}
+		}
+	}
+
+	cv::Mat labels;
+	cv::kmeans(samples,
+			clusters,
+			labels,
+			cv::TermCriteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS, 20, 0.001),
+			1,
+			cv::KMEANS_PP_CENTERS,
+			centers_);
+	descriptorsType_ = type;
+	descriptorsDim_ = cols;
+
+	if(dim > 0 && dim < centers_.rows*centers_.cols)
+	{
+		if(objects > dim)
+		{
+			int pcaStep = objects > maxPcaSamples?objects/maxPcaSamples+1:1;
+			cv::Mat vlads;
+			index = 0;
+			for(unsigned int i=0; i<descriptors.size(); ++i)
+			{
+				if(!descriptors[i].empty() && index++ % pcaStep == 0)
+				{
+					vlads.push_back(aggregate(descriptors[i]));
+				}
+			}
+			cv::PCA pca(vlads, cv::Mat(), cv::PCA::DATA_AS_ROW, dim);
+			mean_ = pca.mean;
+			eigenvectors_ = pca.eigenvectors;
+		}
+		else
+		{
+			UWARN("Not enough objects (%d) to reduce VLAD vectors to %d dimensions, keeping %d dimensions.",
+					objects, dim, centers_.rows*centers_.cols);
+		}
+	}
+
+	UINFO("VLAD codebook: %d clusters from %d/%d descriptors, global descriptor dim=%d",
+			centers_.rows, samples.rows, total, this->dim());
+	return true;
+}
+
+cv::Mat Vlad::compute(const cv::Mat & descriptors) const
+{
+	cv::Mat vlad = aggregate(descriptors);
+	if(!vlad.empty() && !eigenvectors_.empty())
+	{
+		cv::Mat reduced = (vlad - mean_) * eigenvectors_.t();
+		cv::normalize(reduced, vlad);
+	}
+	return vlad;
+}
+
+cv::Mat Vlad::toFloat(const cv::Mat & descriptors)
+{
+	cv::Mat data;
+	if(descriptors.type() == CV_8U)
+	{
+		// binary descriptors: one dimension per bit
+		data = cv::Mat(descriptors.rows, descriptors.cols*8, CV_32FC1);
+		for(int i=0; i<descriptors.rows; ++i)
+		{
+			const unsigned char * in = descriptors.ptr<unsigned char>(i);
+			float * out = data.ptr<float>(i);
+			for(int j=0; j<descriptors.cols; ++j)
+			{
+				for(int b=0; b<8; ++b)
+				{
+					out[j*8+b] = (in[j] >> b) & 1?1.0f:0.0f;
+				}
+			}
+		}
+	}
+	else if(descriptors.type() != CV_32FC1)
+	{
+		descriptors.convertTo(data, CV_32F);
+	}
+	else
+	{
+		data = descriptors;
+	}
+	return data;
+}
+
+cv::Mat Vlad::aggregate(const cv::Mat & descriptors) const
+{
+	if(centers_.empty() || descriptors.empty())
+	{
+		return cv::Mat();
+	}
+	UASSERT(descriptors.type() == descriptorsType_ && descriptors.cols == descriptorsDim_);
+
+	cv::Mat data = toFloat(descriptors);
+
+	// assign each descriptor to its nearest center
+	std::vector<cv::DMatch> matches;
+	cv::BFMatcher matcher(cv::NORM_L2);
+	matcher.match(data, centers_, matches);
+
+	// sum of the residuals
+	cv::Mat vlad = cv::Mat::zeros(centers_.rows, centers_.cols, CV_32FC1);
+	for(unsigned int i=0; i<matches.size(); ++i)
+	{
+		cv::Mat residual = vlad.row(matches[i].trainIdx);
+		residual += data.row(matches[i].queryIdx);
+		residual -= centers_.row(matches[i].trainIdx);
+	}
+	vlad = vlad.reshape(1, 1);
+
+	// power normalization (signed square root), then L2
+	float * ptr = vlad.ptr<float>(0);
+	for(int i=0; i<vlad.cols; ++i)
+	{
+		ptr[i] = ptr[i]<0.0f?-std::sqrt(-ptr[i]):std::sqrt(ptr[i]);
+	}
+	cv::normalize(vlad, vlad);
+	return vlad;
+}
+
+} // namespace find_object
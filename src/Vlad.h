@@ -0,0 +1,68 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef VLAD_H_
+#define VLAD_H_
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+
+namespace find_object {
+
+// Vector of Locally Aggregated Descriptors: a compact global descriptor
+// computed from the local descriptors of an image.
+class Vlad {
+public:
+	Vlad();
+	virtual ~Vlad();
+
+	void clear();
+	// Learn the codebook (k-means) from the descriptors of the objects. If dim>0, VLAD vectors
+	// of the objects are also used to learn a PCA reducing the global descriptor to dim.
+	bool train(const std::vector<cv::Mat> & descriptors, int clusters, int dim);
+	// Return a L2-normalized 1xdim() CV_32FC1 vector (empty if not trained or no descriptors)
+	cv::Mat compute(const cv::Mat & descriptors) const;
+
+	bool isTrained() const {return !centers_.empty();}
+	int clusters() const {return centers_.rows;}
+	int dim() const {return !eigenvectors_.empty()?eigenvectors_.rows:centers_.rows*centers_.cols;}
+
+private:
+	static cv::Mat toFloat(const cv::Mat & descriptors);
+	cv::Mat aggregate(const cv::Mat & descriptors) const;
+
+private:
+	cv::Mat centers_; // CV_32FC1
+	cv::Mat mean_; // PCA
+	cv::Mat eigenvectors_; // PCA
+	int descriptorsType_;
+	int descriptorsDim_;
+};
+
+} // namespace find_object
+
+#endif /* VLAD_H_ */
@@ -28,12 +28,14 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "find_object/Settings.h"
 
 #include "find_object/utilite/ULogger.h"
+#include "utilite/UConversion.h"
 #include "Compression.h"
 #include "Vocabulary.h"
 #include <QtCore/QVector>
 #include <QDataStream>
 #include <QTime>
 #include <stdio.h>
+#include <algorithm>
 #if CV_MAJOR_VERSION < 3
 #include <opencv2/gpu/gpu.hpp>
 #define CVCUDA cv::gpu
@@ -47,7 +49,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace find_object {
 
-Vocabulary::Vocabulary()
+Vocabulary::Vocabulary() :
+	stopWordsCount_(0),
+	stopWordsEntries_(0),
+	bruteForce_(false)
 {
 }
 
@@ -58,6 +63,7 @@ Vocabulary::~Vocabulary()
 void Vocabulary::clear()
 {
 	wordToObjects_.clear();
+	clearInvertedIndex();
 	notIndexedDescriptors_ = cv::Mat();
 	notIndexedWordIds_.clear();
 
@@ -69,6 +75,7 @@ void Vocabulary::clear()
 		return;
 	}
 
+	tree_.clear();
 	indexedDescriptors_ = cv::Mat();
 }
 
@@ -93,10 +100,11 @@ void Vocabulary::save(QDataStream & streamSessionPtr, bool saveVocabularyOnly) c
 	qint64 dataSize = bytes.size();
 	UINFO("Compressed = %d MB", dataSize/(1024*1024));
 	int old = 0;
+	int treeFollows = tree_.empty()?0:-1; // saved in place of old type
 	if(dataSize <= std::numeric_limits<int>::max())
 	{
 		// old: rows, cols, type
-		streamSessionPtr << old << old << old << dataSize;
+		streamSessionPtr << old << old << treeFollows << dataSize;
 		streamSessionPtr << QByteArray::fromRawData((const char*)bytes.data(), dataSize);
 	}
 	else
@@ -104,13 +112,23 @@ void Vocabulary::save(QDataStream & streamSessionPtr, bool saveVocabularyOnly) c
 		UERROR("Vocabulary (compressed) is too large (%d MB) to be saved! Limit is 2 GB (based on max QByteArray size).",
 				dataSize/(1024*1024));
 		// old: rows, cols, type, dataSize
-		streamSessionPtr << old << old << old << old;
+		streamSessionPtr << old << old << treeFollows << old;
 		streamSessionPtr << QByteArray(); // empty
 	}
+
+	if(!tree_.empty())
+	{
+		UINFO("Saving vocabulary tree (%d nodes)...", tree_.nodes());
+		tree_.save(streamSessionPtr);
+	}
 }
 
 void Vocabulary::load(QDataStream & streamSessionPtr, bool loadVocabularyOnly)
 {
+	// the inverted index is rebuilt when objects are loaded
+	clearInvertedIndex();
+	tree_.clear();
+
 	// load index
 	if(loadVocabularyOnly)
 	{
@@ -130,7 +148,7 @@ void Vocabulary::load(QDataStream & streamSessionPtr, bool loadVocabularyOnly)
 	int rows,cols,type;
 	qint64 dataSize;
 	streamSessionPtr >> rows >> cols >> type >> dataSize;
-	if(rows == 0 && cols == 0 && type == 0)
+	if(rows == 0 && cols == 0 && (type == 0 || type == -1))
 	{
 		// compressed vocabulary
 		UINFO("Loading words... (compressed format: %d MB)", dataSize/(1024*1024));
@@ -159,6 +177,12 @@ void Vocabulary::load(QDataStream & streamSessionPtr, bool loadVocabularyOnly)
 		}
 	}
 
+	if(type == -1)
+	{
+		UINFO("Loading vocabulary tree...");
+		tree_.load(streamSessionPtr);
+	}
+
 	UINFO("Update vocabulary index...");
 	update();
 }
@@ -170,6 +194,10 @@ bool Vocabulary::save(const QString & filename) const
 	if(fs.isOpened())
 	{
 		fs << "Descriptors" << indexedDescriptors_;
+		if(!tree_.empty())
+		{
+			tree_.write(fs);
+		}
 		return true;
 	}
 	else
@@ -192,7 +220,14 @@ bool Vocabulary::load(const QString & filename)
 		{
 			// clear index
 			wordToObjects_.clear();
+			clearInvertedIndex();
+			tree_.clear();
 			indexedDescriptors_ = tmp;
+			cv::FileNode treeNode = fs["VocabularyTree"];
+			if(!treeNode.empty())
+			{
+				tree_.read(treeNode);
+			}
 			update();
 			return true;
 		}
@@ -414,13 +449,28 @@ void Vocabulary::update()
 		
 		//concatenate descriptors
 		indexedDescriptors_.push_back(notIndexedDescriptors_);
+		tree_.clear();
 
 		notIndexedDescriptors_ = cv::Mat();
 		notIndexedWordIds_.clear();
 	}
 
-	if(!indexedDescriptors_.empty() && !Settings::isBruteForceNearestNeighbor())
+	if(!indexedDescriptors_.empty() && Settings::isVocabularyTreeNearestNeighbor() && !bruteForce_)
+	{
+		// a loaded tree is kept if it was built over the same words with the same parameters
+		if(tree_.words() != indexedDescriptors_.rows ||
+		   tree_.branching() != Settings::getNearestNeighbor_VocabularyTree_branching() ||
+		   tree_.depth() != Settings::getNearestNeighbor_VocabularyTree_depth())
+		{
+			tree_.build(indexedDescriptors_,
+					Settings::getNearestNeighbor_VocabularyTree_branching(),
+					Settings::getNearestNeighbor_VocabularyTree_depth(),
+					Settings::getNearestNeighbor_VocabularyTree_iterations());
+		}
+	}
+	else if(!indexedDescriptors_.empty() && !isBruteForce())
 	{
+		tree_.clear();
 		cv::flann::IndexParams * params = Settings::createFlannIndexParams();
 #if CV_MAJOR_VERSION == 2 and CV_MINOR_VERSION == 4 and CV_SUBMINOR_VERSION >= 12
 		flannIndex_.build(indexedDescriptors_, cv::Mat(), *params, Settings::getFlannDistanceType());
@@ -431,7 +481,149 @@ void Vocabulary::update()
 	}
 }
 
-void Vocabulary::search(const cv::Mat & descriptorsIn, cv::Mat & results, cv::Mat & dists, int k)
+bool Vocabulary::isBruteForce() const
+{
+	return bruteForce_ || Settings::isBruteForceNearestNeighbor();
+}
+
+void Vocabulary::build(const cv::Mat & descriptorsIn)
+{
+	wordToObjects_.clear();
+	clearInvertedIndex();
+	notIndexedDescriptors_ = cv::Mat();
+	notIndexedWordIds_.clear();
+	tree_.clear();
+
+	if(descriptorsIn.type() == CV_8U && Settings::getNearestNeighbor_7ConvertBinToFloat())
+	{
+		descriptorsIn.convertTo(indexedDescriptors_, CV_32F);
+	}
+	else
+	{
+		indexedDescriptors_ = descriptorsIn;
+	}
+	update();
+}
+
+void Vocabulary::clearInvertedIndex()
+{
+	invertedIndexOffsets_.clear();
+	invertedIndexEntries_.clear();
+	invertedIndexObjects_.clear();
+	invertedIndexObjectsWords_.clear();
+	invertedIndexIdf_.clear();
+	documentFrequencies_.clear();
+	stopWords_.clear();
+	stopWordsCount_ = 0;
+	stopWordsEntries_ = 0;
+}
+
+void Vocabulary::updateInvertedIndex(const QMap<int, QMultiMap<int, int> > & objectsWords, float maxDocumentFrequency)
+{
+	clearInvertedIndex();
+
+	int wordsCount = this->size();
+	if(wordsCount == 0)
+	{
+		return;
+	}
+
+	// First pass: count the objects referring to each word
+	std::vector<int> counts(wordsCount, 0);
+	int total = 0;
+	for(QMap<int, QMultiMap<int, int> >::const_iterator iter=objectsWords.constBegin(); iter!=objectsWords.constEnd(); ++iter)
+	{
+		for(QMultiMap<int, int>::const_iterator jter=iter.value().constBegin(); jter!=iter.value().constEnd(); jter = iter.value().upperBound(jter.key()))
+		{
+			// invalid words (-1) are ignored
+			if(jter.key() >= 0)
+			{
+				UASSERT_MSG(jter.key() < wordsCount, uFormat("word=%d vocabulary=%d", jter.key(), wordsCount).c_str());
+				++counts[jter.key()];
+				++total;
+			}
+		}
+	}
+
+	// Stop words: words referred by too many objects are not discriminative
+	documentFrequencies_ = counts;
+	stopWords_.resize(wordsCount, 0);
+	// With less than 1/maxDocumentFrequency objects, the limit would be
+	// under one object and all words would be stop words: no pruning.
+	if(maxDocumentFrequency > 0.0f && maxDocumentFrequency * float(objectsWords.size()) < 1.0f)
+	{
+		UDEBUG("Stop words: not enough objects (%d) for a maximum document frequency of %.1f%%",
+				objectsWords.size(), maxDocumentFrequency*100.0f);
+	}
+	else if(maxDocumentFrequency > 0.0f)
+	{
+		int maxCount = std::max(1, int(maxDocumentFrequency * float(objectsWords.size())));
+		for(int i=0; i<wordsCount; ++i)
+		{
+			if(counts[i] > maxCount)
+			{
+				stopWords_[i] = 1;
+				++stopWordsCount_;
+				stopWordsEntries_ += counts[i];
+				total -= counts[i];
+				counts[i] = 0;
+			}
+		}
+		UINFO("Stop words: %d/%d words referred by more than %d objects (%.1f%% of %d objects), %d inverted index entries pruned",
+				stopWordsCount_, wordsCount, maxCount, maxDocumentFrequency*100.0f, objectsWords.size(), stopWordsEntries_);
+	}
+
+	invertedIndexOffsets_.resize(wordsCount+1);
+	invertedIndexOffsets_[0] = 0;
+	for(int i=0; i<wordsCount; ++i)
+	{
+		invertedIndexOffsets_[i+1] = invertedIndexOffsets_[i] + counts[i];
+	}
+
+	// Second pass: fill the entries, sorted by object for each word
+	std::vector<int> cursors(invertedIndexOffsets_.begin(), invertedIndexOffsets_.end()-1);
+	invertedIndexEntries_.resize(total);
+	invertedIndexObjects_.reserve(objectsWords.size());
+	invertedIndexObjectsWords_.resize(objectsWords.size(), 0);
+	for(QMap<int, QMultiMap<int, int> >::const_iterator iter=objectsWords.constBegin(); iter!=objectsWords.constEnd(); ++iter)
+	{
+		int objectIndex = (int)invertedIndexObjects_.size();
+		invertedIndexObjects_.push_back(iter.key());
+		const QMultiMap<int, int> & words = iter.value();
+		QMultiMap<int, int>::const_iterator jter=words.constBegin();
+		while(jter!=words.constEnd())
+		{
+			int wordId = jter.key();
+			int keypointIndex = jter.value();
+			int count = 0;
+			for(; jter!=words.constEnd() && jter.key() == wordId; ++jter)
+			{
+				++count;
+			}
+			if(wordId >= 0 && !stopWords_[wordId])
+			{
+				InvertedIndexEntry & entry = invertedIndexEntries_[cursors[wordId]++];
+				entry.objectIndex = objectIndex;
+				entry.keypointIndex = keypointIndex;
+				entry.unique = count == 1;
+				++invertedIndexObjectsWords_[objectIndex];
+			}
+		}
+	}
+
+	// idf = log(N/n), with N the number of objects and n the number of objects having the word
+	invertedIndexIdf_.resize(wordsCount, 0.0f);
+	for(int i=0; i<wordsCount; ++i)
+	{
+		if(counts[i])
+		{
+			invertedIndexIdf_[i] = std::log(float(invertedIndexObjects_.size()) / float(counts[i]));
+		}
+	}
+	UDEBUG("Inverted index: %d words, %d entries, %d objects", wordsCount, total, (int)invertedIndexObjects_.size());
+}
+
+void Vocabulary::search(const cv::Mat & descriptorsIn, cv::Mat & results, cv::Mat & dists, int k, int checks)
 {
 	if(!indexedDescriptors_.empty())
 	{
@@ -447,7 +639,11 @@ void Vocabulary::search(const cv::Mat & descriptorsIn, cv::Mat & results, cv::Ma
 
 		UASSERT(descriptors.type() == indexedDescriptors_.type() && descriptors.cols == indexedDescriptors_.cols);
 
-		if(Settings::isBruteForceNearestNeighbor())
+		if(Settings::isVocabularyTreeNearestNeighbor() && !bruteForce_)
+		{
+			tree_.search(indexedDescriptors_, descriptors, results, dists, k);
+		}
+		else if(isBruteForce())
 		{
 			std::vector<std::vector<cv::DMatch> > matches;
 			if(Settings::getNearestNeighbor_BruteForce_gpu() && CVCUDA::getCudaEnabledDeviceCount())
@@ -505,7 +701,7 @@ void Vocabulary::search(const cv::Mat & descriptorsIn, cv::Mat & results, cv::Ma
 		{
 			flannIndex_.knnSearch(descriptors, results, dists, k,
 					cv::flann::SearchParams(
-						Settings::getNearestNeighbor_search_checks(),
+						checks>0?checks:Settings::getNearestNeighbor_search_checks(),
 						Settings::getNearestNeighbor_search_eps(),
 						Settings::getNearestNeighbor_search_sorted()));
 		}
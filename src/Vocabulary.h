@@ -31,10 +31,21 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <QtCore/QMultiMap>
 #include <QtCore/QVector>
 #include <opencv2/opencv.hpp>
+#include "VocabularyTree.h"
+#include <vector>
 
 namespace find_object {
 
 class Vocabulary {
+public:
+	// Entry of the inverted index, see invertedIndexOffsets()
+	struct InvertedIndexEntry
+	{
+		int objectIndex;   // index in invertedIndexObjects()
+		int keypointIndex; // keypoint of the object referring to the word
+		bool unique;       // false if more than one keypoint of the object refer to the word
+	};
+
 public:
 	Vocabulary();
 	virtual ~Vocabulary();
@@ -42,12 +53,34 @@ public:
 	void clear();
 	QMultiMap<int, int> addWords(const cv::Mat & descriptors, int objectId);
 	void update();
-	void search(const cv::Mat & descriptors, cv::Mat & results, cv::Mat & dists, int k);
+	void build(const cv::Mat & descriptors); // index descriptors directly as words (no object references)
+	// Use brute force matching whatever the nearest neighbor strategy (no index is built on update())
+	void setBruteForce(bool bruteForce) {bruteForce_ = bruteForce;}
+	bool isBruteForce() const;
+	// checks: FLANN search checks, 0 means "NearestNeighbor/search_checks"
+	void search(const cv::Mat & descriptors, cv::Mat & results, cv::Mat & dists, int k, int checks = 0);
 	int size() const {return indexedDescriptors_.rows + notIndexedDescriptors_.rows;}
 	int dim() const {return !indexedDescriptors_.empty()?indexedDescriptors_.cols:notIndexedDescriptors_.cols;}
 	int type() const {return !indexedDescriptors_.empty()?indexedDescriptors_.type():notIndexedDescriptors_.type();}
 	const QMultiMap<int, int> & wordToObjects() const {return wordToObjects_;}
 	const cv::Mat & indexedDescriptors() const {return indexedDescriptors_;}
+	const VocabularyTree & tree() const {return tree_;} // built only with "VocabularyTree" nearest neighbor strategy
+
+	// Compressed sparse row inverted index: entries of word w are
+	// [invertedIndexOffsets()[w], invertedIndexOffsets()[w+1]) in invertedIndexEntries().
+	// Words referred by more than maxDocumentFrequency ratio of the objects are stop
+	// words and are not indexed (0 means no stop words).
+	void updateInvertedIndex(const QMap<int, QMultiMap<int, int> > & objectsWords, float maxDocumentFrequency = 0.0f); // <ObjectId, <wordId, keypointIndex> >
+	void clearInvertedIndex();
+	const std::vector<int> & invertedIndexOffsets() const {return invertedIndexOffsets_;}
+	const std::vector<InvertedIndexEntry> & invertedIndexEntries() const {return invertedIndexEntries_;}
+	const std::vector<int> & invertedIndexObjects() const {return invertedIndexObjects_;}
+	const std::vector<int> & invertedIndexObjectsWords() const {return invertedIndexObjectsWords_;} // unique words per object index
+	const std::vector<float> & invertedIndexIdf() const {return invertedIndexIdf_;} // inverse document frequency per word
+	const std::vector<int> & documentFrequencies() const {return documentFrequencies_;} // number of objects referring to each word
+	const std::vector<unsigned char> & stopWords() const {return stopWords_;} // 1 if the word is a stop word
+	int stopWordsCount() const {return stopWordsCount_;}
+	int stopWordsEntries() const {return stopWordsEntries_;} // entries pruned from the inverted index
 
 	void save(QDataStream & streamSessionPtr, bool saveVocabularyOnly = false) const;
 	void load(QDataStream & streamSessionPtr, bool loadVocabularyOnly = false);
@@ -56,10 +89,21 @@ public:
 
 private:
 	cv::flann::Index flannIndex_;
+	VocabularyTree tree_;
 	cv::Mat indexedDescriptors_;
 	cv::Mat notIndexedDescriptors_;
 	QMultiMap<int, int> wordToObjects_; // <wordId, ObjectId>
 	QVector<int> notIndexedWordIds_;
+	std::vector<int> invertedIndexOffsets_;
+	std::vector<InvertedIndexEntry> invertedIndexEntries_;
+	std::vector<int> invertedIndexObjects_; // object index -> ObjectId
+	std::vector<int> invertedIndexObjectsWords_;
+	std::vector<float> invertedIndexIdf_;
+	std::vector<int> documentFrequencies_;
+	std::vector<unsigned char> stopWords_;
+	int stopWordsCount_;
+	int stopWordsEntries_;
+	bool bruteForce_;
 };
 
 } // namespace find_object
@@ -0,0 +1,452 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "find_object/utilite/ULogger.h"
+#include "Compression.h"
+#include "VocabularyTree.h"
+#include <QtCore/QByteArray>
+#include <QtCore/QTime>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+namespace find_object {
+
+static int hammingDistance(const unsigned char * a, const unsigned char * b, int size)
+{
+	int dist = 0;
+	for(int i=0; i<size; ++i)
+	{
+		unsigned char v = a[i] ^ b[i];
+		v = v - ((v >> 1) & 0x55);
+		v = (v & 0x33) + ((v >> 2) & 0x33);
+		dist += (v + (v >> 4)) & 0x0F;
+	}
+	return dist;
+}
+
+static float squaredL2Distance(const float * a, const float * b, int size)
+{
+	float dist = 0.0f;
+	for(int i=0; i<size; ++i)
+	{
+		float diff = a[i] - b[i];
+		dist += diff*diff;
+	}
+	return dist;
+}
+
+// Hamming distance for binary descriptors, squared L2 distance otherwise
+static float descriptorDistance(const cv::Mat & a, int i, const cv::Mat & b, int j)
+{
+	if(a.type() == CV_8U)
+	{
+		return (float)hammingDistance(a.ptr<unsigned char>(i), b.ptr<unsigned char>(j), a.cols);
+	}
+	return squaredL2Distance(a.ptr<float>(i), b.ptr<float>(j), a.cols);
+}
+
+// k-means for binary descriptors: centers are the bitwise majority of their members
+static void kMajority(const cv::Mat & data, int k, int iterations, std::vector<int> & labels, cv::Mat & centers)
+{
+	cv::RNG & rng = cv::theRNG();
+	std::vector<int> indices(data.rows);
+	for(int i=0; i<data.rows; ++i)
+	{
+		indices[i] = i;
+	}
+	centers = cv::Mat(k, data.cols, CV_8UC1);
+	for(int i=0; i<k; ++i)
+	{
+		std::swap(indices[i], indices[i + rng.uniform(0, data.rows-i)]);
+		data.row(indices[i]).copyTo(centers.row(i));
+	}
+
+	labels.assign(data.rows, -1);
+	std::vector<int> bitCounts(k*data.cols*8);
+	std::vector<int> members(k);
+	for(int it=0; it<iterations; ++it)
+	{
+		bool changed = false;
+		for(int i=0; i<data.rows; ++i)
+		{
+			int best = 0;
+			float bestDist = descriptorDistance(data, i, centers, 0);
+			for(int c=1; c<k; ++c)
+			{
+				float dist = descriptorDistance(data, i, centers, c);
+				if(dist < bestDist)
+				{
+					best = c;
+					bestDist = dist;
+				}
+			}
+			if(labels[i] != best)
+			{
+				labels[i] = best;
+				changed = true;
+			}
+		}
+		if(!changed)
+		{
+			break;
+		}
+
+		std::fill(bitCounts.begin(), bitCounts.end(), 0);
+		std::fill(members.begin(), members.end(), 0);
+		for(int i=0; i<data.rows; ++i)
+		{
+			const unsigned char * ptr = data.ptr<unsigned char>(i);
+			int * counts = &bitCounts[labels[i]*data.cols*8];
+			++members[labels[i]];
+			for(int j=0; j<data.cols; ++j)
+			{
+				for(int b=0; b<8; ++b)
+				{
+					counts[j*8+b] += (ptr[j] >> b) & 1;
+				}
+			}
+		}
+		for(int c=0; c<k; ++c)
+		{
+			if(members[c])
+			{
+				unsigned char * ptr = centers.ptr<unsigned char>(c);
+				const int * counts = &bitCounts[c*data.cols*8];
+				for(int j=0; j<data.cols; ++j)
+				{
+					unsigned char value = 0;
+					for(int b=0; b<8; ++b)
+					{
+						if(counts[j*8+b]*2 > members[c])
+						{
+							value |= 1 << b;
+						}
+					}
+					ptr[j] = value;
+				}
+			}
+		}
+	}
+}
+
+static void saveMat(QDataStream & streamPtr, const cv::Mat & data)
+{
+	std::vector<unsigned char> bytes = compressData(data);
+	streamPtr << QByteArray::fromRawData((const char*)bytes.data(), (int)bytes.size());
+}
+
+static cv::Mat loadMat(QDataStream & streamPtr)
+{
+	QByteArray data;
+	streamPtr >> data;
+	return uncompressData((unsigned const char*)data.data(), data.size());
+}
+
+static void loadVector(QDataStream & streamPtr, std::vector<int> & values)
+{
+	cv::Mat data = loadMat(streamPtr);
+	values.clear();
+	if(!data.empty())
+	{
+		UASSERT(data.type() == CV_32SC1);
+		values.assign((const int*)data.data, (const int*)data.data + data.total());
+	}
+}
+
+VocabularyTree::VocabularyTree() :
+	branching_(0),
+	depth_(0)
+{
+}
+
+VocabularyTree::~VocabularyTree()
+{
+}
+
+void VocabularyTree::clear()
+{
+	branching_ = 0;
+	depth_ = 0;
+	centers_ = cv::Mat();
+	childrenOffsets_.clear();
+	leafWordsOffsets_.clear();
+	leafWords_.clear();
+}
+
+void VocabularyTree::build(const cv::Mat & words, int branching, int depth, int iterations)
+{
+	clear();
+	if(words.empty())
+	{
+		return;
+	}
+	UASSERT(words.type() == CV_8UC1 || words.type() == CV_32FC1);
+	UASSERT(branching >= 2 && depth >= 1);
+
+	QTime time;
+	time.start();
+
+	branching_ = branching;
+	depth_ = depth;
+	if(iterations <= 0)
+	{
+		iterations = 100;
+	}
+
+	// Nodes are created in breadth-first order, so children of each node are contiguous
+	std::vector<std::vector<int> > members(1);
+	std::vector<int> levels(1, 0);
+	members[0].resize(words.rows);
+	for(int i=0; i<words.rows; ++i)
+	{
+		members[0][i] = i;
+	}
+	centers_ = cv::Mat::zeros(1, words.cols, words.type());
+	leafWords_.reserve(words.rows);
+	for(int n=0; n<(int)members.size(); ++n)
+	{
+		childrenOffsets_.push_back((int)members.size());
+		leafWordsOffsets_.push_back((int)leafWords_.size());
+
+		std::vector<int> ids;
+		ids.swap(members[n]);
+		int level = levels[n];
+		if(level < depth && (int)ids.size() > branching)
+		{
+			cv::Mat data((int)ids.size(), words.cols, words.type());
+			for(unsigned int i=0; i<ids.size(); ++i)
+			{
+				words.row(ids[i]).copyTo(data.row(i));
+			}
+
+			std::vector<int> labels;
+			cv::Mat centers;
+			if(words.type() == CV_8U)
+			{
+				kMajority(data, branching, iterations, labels, centers);
+			}
+			else
+			{
+				cv::Mat labelsMat;
+				cv::kmeans(data,
+						branching,
+						labelsMat,
+						cv::TermCriteria(cv::TermCriteria::COUNT+cv::TermCriteria::EPS, iterations, 0.0001),
+						1,
+						cv::KMEANS_PP_CENTERS,
+						centers);
+				labels.assign((const int*)labelsMat.data, (const int*)labelsMat.data + labelsMat.total());
+			}
+
+			std::vector<std::vector<int> > clusters(branching);
+			for(unsigned int i=0; i<labels.size(); ++i)
+			{
+				clusters[labels[i]].push_back(ids[i]);
+			}
+			int nonEmpty = 0;
+			for(int c=0; c<branching; ++c)
+			{
+				nonEmpty += clusters[c].empty()?0:1;
+			}
+
+			// Don't split if all words fall in the same cluster (e.g., duplicated descriptors)
+			if(nonEmpty > 1)
+			{
+				for(int c=0; c<branching; ++c)
+				{
+					if(!clusters[c].empty())
+					{
+						centers_.push_back(centers.row(c));
+						members.push_back(std::vector<int>());
+						members.back().swap(clusters[c]);
+						levels.push_back(level+1);
+					}
+				}
+			}
+		}
+
+		if((int)members.size() == childrenOffsets_.back())
+		{
+			// leaf
+			leafWords_.insert(leafWords_.end(), ids.begin(), ids.end());
+		}
+	}
+	childrenOffsets_.push_back((int)members.size());
+	leafWordsOffsets_.push_back((int)leafWords_.size());
+
+	UINFO("Vocabulary tree built: %d words, %d nodes (branching=%d, depth=%d, %d ms)",
+			words.rows, centers_.rows, branching_, depth_, time.elapsed());
+}
+
+static void pushBranch(std::vector<std::pair<float, int> > & branches, float dist, int node)
+{
+	branches.push_back(std::make_pair(dist, node));
+	std::push_heap(branches.begin(), branches.end(), std::greater<std::pair<float, int> >());
+}
+
+void VocabularyTree::search(const cv::Mat & words, const cv::Mat & descriptors, cv::Mat & results, cv::Mat & dists, int k) const
+{
+	UASSERT(k > 0);
+	// Missing neighbors (tree with less than k words) have index -1 and maximum distance
+	results = cv::Mat(descriptors.rows, k, CV_32SC1, cv::Scalar(-1));
+	dists = cv::Mat(descriptors.rows, k, CV_32FC1, cv::Scalar(std::numeric_limits<float>::max()));
+	if(this->empty() || descriptors.empty())
+	{
+		return;
+	}
+	UASSERT(descriptors.type() == centers_.type() && descriptors.cols == centers_.cols);
+	UASSERT(words.type() == centers_.type() && words.rows == this->words());
+
+	std::vector<std::pair<float, int> > branches; // min-heap of <distance to center, node> not visited
+	for(int i=0; i<descriptors.rows; ++i)
+	{
+		int * r = results.ptr<int>(i);
+		float * d = dists.ptr<float>(i);
+
+		// Greedy descent to the closest leaf. While less than k words are
+		// compared (e.g. small leaves), search continues from the closest
+		// branch not visited, so that the second neighbor of the NNDR test
+		// is found if the tree has enough words.
+		int compared = 0;
+		branches.clear();
+		branches.push_back(std::make_pair(0.0f, 0));
+		while(compared < k && !branches.empty())
+		{
+			std::pop_heap(branches.begin(), branches.end(), std::greater<std::pair<float, int> >());
+			int node = branches.back().second;
+			branches.pop_back();
+
+			while(childrenOffsets_[node] < childrenOffsets_[node+1])
+			{
+				int best = -1;
+				float bestDist = 0.0f;
+				for(int c=childrenOffsets_[node]; c<childrenOffsets_[node+1]; ++c)
+				{
+					float dist = descriptorDistance(descriptors, i, centers_, c);
+					if(best < 0 || dist < bestDist)
+					{
+						if(best >= 0)
+						{
+							pushBranch(branches, bestDist, best);
+						}
+						best = c;
+						bestDist = dist;
+					}
+					else
+					{
+						pushBranch(branches, dist, c);
+					}
+				}
+				node = best;
+			}
+
+			// k nearest words of the leaf
+			for(int j=leafWordsOffsets_[node]; j<leafWordsOffsets_[node+1]; ++j)
+			{
+				int wordId = leafWords_[j];
+				float dist = descriptorDistance(descriptors, i, words, wordId);
+				++compared;
+				if(dist < d[k-1])
+				{
+					int m = k-1;
+					for(; m>0 && d[m-1] > dist; --m)
+					{
+						d[m] = d[m-1];
+						r[m] = r[m-1];
+					}
+					d[m] = dist;
+					r[m] = wordId;
+				}
+			}
+		}
+		if(descriptors.type() != CV_8U)
+		{
+			for(int m=0; m<k; ++m)
+			{
+				if(r[m] >= 0)
+				{
+					d[m] = std::sqrt(d[m]);
+				}
+			}
+		}
+	}
+}
+
+void VocabularyTree::save(QDataStream & streamPtr) const
+{
+	streamPtr << branching_ << depth_;
+	saveMat(streamPtr, centers_);
+	saveMat(streamPtr, cv::Mat(childrenOffsets_));
+	saveMat(streamPtr, cv::Mat(leafWordsOffsets_));
+	saveMat(streamPtr, cv::Mat(leafWords_));
+}
+
+void VocabularyTree::load(QDataStream & streamPtr)
+{
+	clear();
+	streamPtr >> branching_ >> depth_;
+	centers_ = loadMat(streamPtr);
+	loadVector(streamPtr, childrenOffsets_);
+	loadVector(streamPtr, leafWordsOffsets_);
+	loadVector(streamPtr, leafWords_);
+	if(childrenOffsets_.size() != (unsigned int)centers_.rows+1 || leafWordsOffsets_.size() != childrenOffsets_.size())
+	{
+		UERROR("Vocabulary tree is corrupted (%d nodes, %d offsets), it will be rebuilt.", centers_.rows, (int)childrenOffsets_.size());
+		clear();
+	}
+}
+
+void VocabularyTree::write(cv::FileStorage & fs) const
+{
+	fs << "VocabularyTree" << "{";
+	fs << "branching" << branching_;
+	fs << "depth" << depth_;
+	fs << "centers" << centers_;
+	fs << "childrenOffsets" << childrenOffsets_;
+	fs << "leafWordsOffsets" << leafWordsOffsets_;
+	fs << "leafWords" << leafWords_;
+	fs << "}";
+}
+
+void VocabularyTree::read(const cv::FileNode & node)
+{
+	clear();
+	branching_ = (int)node["branching"];
+	depth_ = (int)node["depth"];
+	node["centers"] >> centers_;
+	node["childrenOffsets"] >> childrenOffsets_;
+	node["leafWordsOffsets"] >> leafWordsOffsets_;
+	node["leafWords"] >> leafWords_;
+	if(childrenOffsets_.size() != (unsigned int)centers_.rows+1 || leafWordsOffsets_.size() != childrenOffsets_.size())
+	{
+		UERROR("Vocabulary tree is corrupted (%d nodes, %d offsets), it will be rebuilt.", centers_.rows, (int)childrenOffsets_.size());
+		clear();
+	}
+}
+
+} // namespace find_object
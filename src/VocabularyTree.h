@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef VOCABULARYTREE_H_
+#define VOCABULARYTREE_H_
+
+#include <opencv2/opencv.hpp>
+#include <QtCore/QDataStream>
+#include <vector>
+
+namespace find_object {
+
+// Hierarchical k-means tree (k-majority for binary descriptors) built over
+// the words of a vocabulary. A descriptor is quantized by greedy descent
+// from the root, then compared only to the words of the leaf reached.
+class VocabularyTree {
+public:
+	VocabularyTree();
+	virtual ~VocabularyTree();
+
+	void clear();
+	void build(const cv::Mat & words, int branching, int depth, int iterations);
+	// words should be the same matrix used to build the tree
+	void search(const cv::Mat & words, const cv::Mat & descriptors, cv::Mat & results, cv::Mat & dists, int k) const;
+
+	bool empty() const {return childrenOffsets_.empty();}
+	int branching() const {return branching_;}
+	int depth() const {return depth_;}
+	int words() const {return (int)leafWords_.size();}
+	int nodes() const {return centers_.rows;}
+
+	// Node-level inverted files: words of node n are
+	// [leafWordsOffsets()[n], leafWordsOffsets()[n+1]) in leafWords() (empty for internal nodes)
+	const std::vector<int> & leafWordsOffsets() const {return leafWordsOffsets_;}
+	const std::vector<int> & leafWords() const {return leafWords_;}
+
+	void save(QDataStream & streamPtr) const;
+	void load(QDataStream & streamPtr);
+	void write(cv::FileStorage & fs) const;
+	void read(const cv::FileNode & node);
+
+private:
+	int branching_;
+	int depth_;
+	cv::Mat centers_; // one row per node, same type as the words (row 0 is the root)
+	std::vector<int> childrenOffsets_; // children of node n are nodes [childrenOffsets_[n], childrenOffsets_[n+1])
+	std::vector<int> leafWordsOffsets_;
+	std::vector<int> leafWords_;
+};
+
+} // namespace find_object
+
+#endif /* VOCABULARYTREE_H_ */
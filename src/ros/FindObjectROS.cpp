@@ -50,11 +50,17 @@ FindObjectROS::FindObjectROS(QObject * parent) :
 	pubStamped_ = nh.advertise<find_object_2d::ObjectsStamped>("objectsStamped", 1);
 	pubInfo_ = nh.advertise<find_object_2d::DetectionInfo>("info", 1);
 
-	this->connect(this, SIGNAL(objectsFound(find_object::DetectionInfo)), this, SLOT(publish(find_object::DetectionInfo)));
+	this->connect(this, SIGNAL(objectsFound(find_object::DetectionInfoPtr)), this, SLOT(publish(find_object::DetectionInfoPtr)));
 }
 
-void FindObjectROS::publish(const find_object::DetectionInfo & info)
+void FindObjectROS::publish(const find_object::DetectionInfoPtr & infoPtr)
 {
+	if(!infoPtr)
+	{
+		return;
+	}
+	const find_object::DetectionInfo & info = *infoPtr;
+
 	// send tf before the message
 	if(info.objDetected_.size() && !depth_.empty() && depthConstant_ != 0.0f)
 	{
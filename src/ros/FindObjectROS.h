@@ -48,7 +48,7 @@ public:
 	virtual ~FindObjectROS() {}
 
 public Q_SLOTS:
-	void publish(const find_object::DetectionInfo & info);
+	void publish(const find_object::DetectionInfoPtr & infoPtr);
 
 	void setDepthData(const std::string & frameId,
 			const ros::Time & stamp,
@@ -154,9 +154,9 @@ int main(int argc, char** argv)
 
 		QObject::connect(
 				&mainWindow,
-				SIGNAL(objectsFound(const find_object::DetectionInfo &)),
+				SIGNAL(objectsFound(const find_object::DetectionInfoPtr &)),
 				findObjectROS,
-				SLOT(publish(const find_object::DetectionInfo &)));
+				SLOT(publish(const find_object::DetectionInfoPtr &)));
 
 		QStringList topics = camera->subscribedTopics();
 		if(topics.size() == 1)
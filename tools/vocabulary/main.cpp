@@ -0,0 +1,492 @@
+/*
+Copyright (c) 2011-2014, Mathieu Labbe - IntRoLab - Universite de Sherbrooke
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the Universite de Sherbrooke nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QtCore/QCoreApplication>
+#include <QtCore/QDir>
+#include <QtCore/QFileInfo>
+#include <QtCore/QThread>
+#include <QtCore/QTime>
+#include <opencv2/opencv.hpp>
+#include <find_object/FindObject.h>
+#include <find_object/Settings.h>
+#include <find_object/utilite/ULogger.h>
+#include "ObjSignature.h"
+#include <stdio.h>
+
+void showUsage()
+{
+	printf("\nvocabulary [options] output.yaml\n"
+			"  Train a vocabulary loadable by \"General/vocabularyFixed\" (see --vocabulary option\n"
+			"  of find_object or FindObject::loadVocabulary()). Descriptors are extracted with the\n"
+			"  parameters of the configuration file, then clustered with mini-batch k-means\n"
+			"  (k-majority for binary descriptors).\n"
+			"  Options:\n"
+			"    --images \"path\"         Directory of images.\n"
+			"    --session \"path.bin\"    Session: descriptors of its objects are used.\n"
+			"    --config \"path.ini\"     Configuration file (default: none, default parameters).\n"
+			"    --words #               Number of words (default 10000).\n"
+			"    --max_descriptors #     Maximum descriptors kept in memory, uniformly sampled\n"
+			"                            from all descriptors extracted (default 1000000).\n"
+			"    --batch #               Mini-batch size (default 10000).\n"
+			"    --iterations #          Mini-batch iterations (default 100).\n"
+			"    --chunk #               Images processed at the same time (default 100).\n"
+			"    --threads #             Threads used to assign descriptors (default: number of cores).\n"
+			"    --help                  Show this help.\n"
+			"  Example:\n"
+			"     $ vocabulary --images ~/catalog --config ~/find_object.ini --words 50000 vocabulary.yaml.gz\n");
+	exit(-1);
+}
+
+int parsePositiveInt(int argc, char * argv[], int i, const char * option)
+{
+	int value = i < argc-1?atoi(argv[i]):0;
+	if(value <= 0)
+	{
+		printf("error parsing %s\n", option);
+		showUsage();
+	}
+	return value;
+}
+
+// Uniform sample (reservoir) of all descriptors seen
+class DescriptorsReservoir
+{
+public:
+	DescriptorsReservoir(int maxSize) :
+		maxSize_(maxSize),
+		seen_(0),
+		rng_(0x2424)
+	{}
+
+	void add(const cv::Mat & descriptors)
+	{
+		if(descriptors.empty())
+		{
+			return;
+		}
+		if(!samples_.empty() && (samples_.type() != descriptors.type() || samples_.cols != descriptors.cols))
+		{
+			UERROR("Descriptors are not all the same type/size! Ignoring %d descriptors.", descriptors.rows);
+			return;
+		}
+		for(int i=0; i<descriptors.rows; ++i)
+		{
+			if(samples_.rows < maxSize_)
+			{
+				samples_.push_back(descriptors.row(i));
+			}
+			else
+			{
+				qint64 j = qint64(rng_.uniform(0.0, 1.0) * double(seen_+1));
+				if(j < maxSize_)
+				{
+					descriptors.row(i).copyTo(samples_.row((int)j));
+				}
+			}
+			++seen_;
+		}
+	}
+
+	const cv::Mat & samples() const {return samples_;}
+	qint64 seen() const {return seen_;}
+
+private:
+	int maxSize_;
+	qint64 seen_;
+	cv::RNG rng_;
+	cv::Mat samples_;
+};
+
+// Assign descriptors [begin, end) of the batch to their nearest center
+class AssignmentThread : public QThread
+{
+public:
+	AssignmentThread(const cv::Mat * batch, int begin, int end, const cv::Mat * centers, cv::flann::Index * index, std::vector<int> * labels) :
+		batch_(batch),
+		begin_(begin),
+		end_(end),
+		centers_(centers),
+		index_(index),
+		labels_(labels)
+	{}
+
+protected:
+	virtual void run()
+	{
+		cv::Mat descriptors = batch_->rowRange(begin_, end_);
+		if(index_)
+		{
+			cv::Mat results;
+			cv::Mat dists;
+			index_->knnSearch(descriptors, results, dists, 1, cv::flann::SearchParams(32));
+			for(int i=0; i<results.rows; ++i)
+			{
+				(*labels_)[begin_+i] = results.at<int>(i,0);
+			}
+		}
+		else
+		{
+			std::vector<cv::DMatch> matches;
+			cv::BFMatcher matcher(cv::NORM_HAMMING);
+			matcher.match(descriptors, *centers_, matches);
+			for(unsigned int i=0; i<matches.size(); ++i)
+			{
+				(*labels_)[begin_+matches[i].queryIdx] = matches[i].trainIdx;
+			}
+		}
+	}
+
+private:
+	const cv::Mat * batch_;
+	int begin_;
+	int end_;
+	const cv::Mat * centers_;
+	cv::flann::Index * index_; // float descriptors only (read-only search)
+	std::vector<int> * labels_;
+};
+
+// Mini-batch k-means (Sculley 2010). For binary descriptors, each center is
+// the bitwise majority of all descriptors assigned to it so far (k-majority).
+cv::Mat trainVocabulary(const cv::Mat & samples, int words, int batchSize, int iterations, int threads)
+{
+	cv::RNG rng(0x4242);
+	bool binary = samples.type() == CV_8U;
+
+	// Initialize centers with random samples
+	std::vector<int> indices(samples.rows);
+	for(int i=0; i<samples.rows; ++i)
+	{
+		indices[i] = i;
+	}
+	cv::Mat centers(words, samples.cols, samples.type());
+	for(int i=0; i<words; ++i)
+	{
+		std::swap(indices[i], indices[i + rng.uniform(0, samples.rows-i)]);
+		samples.row(indices[i]).copyTo(centers.row(i));
+	}
+
+	std::vector<int> counts(words, 0);
+	std::vector<int> bitCounts;
+	if(binary)
+	{
+		bitCounts.resize(words*samples.cols*8, 0);
+	}
+
+	batchSize = std::min(batchSize, samples.rows);
+	cv::Mat batch(batchSize, samples.cols, samples.type());
+	std::vector<int> labels(batchSize);
+	for(int it=0; it<iterations; ++it)
+	{
+		QTime time;
+		time.start();
+		for(int i=0; i<batchSize; ++i)
+		{
+			samples.row(rng.uniform(0, samples.rows)).copyTo(batch.row(i));
+		}
+
+		// Assignment step (parallel)
+		cv::flann::Index * index = 0;
+		if(!binary)
+		{
+			index = new cv::flann::Index(centers, cv::flann::KDTreeIndexParams(4));
+		}
+		std::vector<AssignmentThread*> workers;
+		int step = (batchSize + threads - 1) / threads;
+		for(int i=0; i<batchSize; i+=step)
+		{
+			workers.push_back(new AssignmentThread(&batch, i, std::min(i+step, batchSize), &centers, index, &labels));
+			workers.back()->start();
+		}
+		for(unsigned int i=0; i<workers.size(); ++i)
+		{
+			workers[i]->wait();
+			delete workers[i];
+		}
+		delete index;
+
+		// Update step, with per-center learning rate 1/count
+		for(int i=0; i<batchSize; ++i)
+		{
+			int c = labels[i];
+			++counts[c];
+			if(binary)
+			{
+				const unsigned char * in = batch.ptr<unsigned char>(i);
+				unsigned char * out = centers.ptr<unsigned char>(c);
+				int * bits = &bitCounts[c*samples.cols*8];
+				for(int j=0; j<samples.cols; ++j)
+				{
+					unsigned char value = 0;
+					for(int b=0; b<8; ++b)
+					{
+						bits[j*8+b] += (in[j] >> b) & 1;
+						if(bits[j*8+b]*2 > counts[c])
+						{
+							value |= 1 << b;
+						}
+					}
+					out[j] = value;
+				}
+			}
+			else
+			{
+				float rate = 1.0f / float(counts[c]);
+				const float * in = batch.ptr<float>(i);
+				float * out = centers.ptr<float>(c);
+				for(int j=0; j<samples.cols; ++j)
+				{
+					out[j] += rate * (in[j] - out[j]);
+				}
+			}
+		}
+		UINFO("Iteration %d/%d (%d ms)", it+1, iterations, time.elapsed());
+	}
+
+	int empty = 0;
+	for(int i=0; i<words; ++i)
+	{
+		empty += counts[i]==0?1:0;
+	}
+	if(empty)
+	{
+		UWARN("%d words have never been assigned (they stay on their initial sample).", empty);
+	}
+	return centers;
+}
+
+int main(int argc, char * argv[])
+{
+	QString imagesPath;
+	QString sessionPath;
+	QString configPath;
+	QString outputPath;
+	int words = 10000;
+	int maxDescriptors = 1000000;
+	int batchSize = 10000;
+	int iterations = 100;
+	int chunk = 100;
+	int threads = QThread::idealThreadCount();
+
+	if(argc < 2)
+	{
+		showUsage();
+	}
+	for(int i=1; i<argc-1; ++i)
+	{
+		if(strcmp(argv[i], "--images") == 0 || strcmp(argv[i], "-images") == 0)
+		{
+			++i;
+			if(i < argc-1)
+			{
+				imagesPath = argv[i];
+			}
+			else
+			{
+				printf("error parsing --images\n");
+				showUsage();
+			}
+			continue;
+		}
+		if(strcmp(argv[i], "--session") == 0 || strcmp(argv[i], "-session") == 0)
+		{
+			++i;
+			if(i < argc-1)
+			{
+				sessionPath = argv[i];
+			}
+			else
+			{
+				printf("error parsing --session\n");
+				showUsage();
+			}
+			continue;
+		}
+		if(strcmp(argv[i], "--config") == 0 || strcmp(argv[i], "-config") == 0)
+		{
+			++i;
+			if(i < argc-1)
+			{
+				configPath = argv[i];
+			}
+			else
+			{
+				printf("error parsing --config\n");
+				showUsage();
+			}
+			continue;
+		}
+		if(strcmp(argv[i], "--words") == 0 || strcmp(argv[i], "-words") == 0)
+		{
+			words = parsePositiveInt(argc, argv, ++i, "--words");
+			continue;
+		}
+		if(strcmp(argv[i], "--max_descriptors") == 0 || strcmp(argv[i], "-max_descriptors") == 0)
+		{
+			maxDescriptors = parsePositiveInt(argc, argv, ++i, "--max_descriptors");
+			continue;
+		}
+		if(strcmp(argv[i], "--batch") == 0 || strcmp(argv[i], "-batch") == 0)
+		{
+			batchSize = parsePositiveInt(argc, argv, ++i, "--batch");
+			continue;
+		}
+		if(strcmp(argv[i], "--iterations") == 0 || strcmp(argv[i], "-iterations") == 0)
+		{
+			iterations = parsePositiveInt(argc, argv, ++i, "--iterations");
+			continue;
+		}
+		if(strcmp(argv[i], "--chunk") == 0 || strcmp(argv[i], "-chunk") == 0)
+		{
+			chunk = parsePositiveInt(argc, argv, ++i, "--chunk");
+			continue;
+		}
+		if(strcmp(argv[i], "--threads") == 0 || strcmp(argv[i], "-threads") == 0)
+		{
+			threads = parsePositiveInt(argc, argv, ++i, "--threads");
+			continue;
+		}
+		if(strcmp(argv[i], "-help") == 0 ||
+		   strcmp(argv[i], "--help") == 0)
+		{
+			showUsage();
+		}
+
+		printf("Unrecognized option: %s\n", argv[i]);
+		showUsage();
+	}
+	outputPath = argv[argc-1];
+	if(threads <= 0)
+	{
+		threads = 1;
+	}
+
+	if(imagesPath.isEmpty() == sessionPath.isEmpty())
+	{
+		printf("One of --images or --session should be set.\n");
+		showUsage();
+	}
+
+	QCoreApplication app(argc, argv);
+	ULogger::setType(ULogger::kTypeConsole);
+	ULogger::setLevel(ULogger::kInfo);
+
+	if(!configPath.isEmpty())
+	{
+		find_object::Settings::init(configPath);
+	}
+
+	QTime totalTime;
+	totalTime.start();
+	DescriptorsReservoir reservoir(maxDescriptors);
+	find_object::FindObject findObject(false);
+	if(!sessionPath.isEmpty())
+	{
+		if(!findObject.loadSession(sessionPath))
+		{
+			UERROR("Could not load session \"%s\"", sessionPath.toStdString().c_str());
+			return -1;
+		}
+		for(QMap<int, find_object::ObjSignature*>::const_iterator iter=findObject.objects().constBegin(); iter!=findObject.objects().constEnd(); ++iter)
+		{
+			reservoir.add(iter.value()->descriptors());
+		}
+	}
+	else
+	{
+		QDir dir(imagesPath);
+		QStringList files = dir.entryList(find_object::Settings::getGeneral_imageFormats().split(' ', QString::SkipEmptyParts), QDir::Files, QDir::Name);
+		if(files.isEmpty())
+		{
+			UERROR("No images found in \"%s\" (formats=%s)", imagesPath.toStdString().c_str(), find_object::Settings::getGeneral_imageFormats().toStdString().c_str());
+			return -1;
+		}
+
+		// Extract descriptors by chunk of images (multi-threaded with "General/threads"), so only sampled descriptors stay in memory
+		for(int i=0; i<files.size(); i+=chunk)
+		{
+			QList<int> ids;
+			for(int j=i; j<i+chunk && j<files.size(); ++j)
+			{
+				QString path = dir.absoluteFilePath(files[j]);
+				cv::Mat image = cv::imread(path.toStdString(), cv::IMREAD_GRAYSCALE);
+				if(!image.empty())
+				{
+					const find_object::ObjSignature * s = findObject.addObject(image, 0, path);
+					if(s)
+					{
+						ids.push_back(s->id());
+					}
+				}
+				else
+				{
+					UWARN("Cannot read image \"%s\"", path.toStdString().c_str());
+				}
+			}
+			findObject.updateObjects(ids);
+			for(int j=0; j<ids.size(); ++j)
+			{
+				reservoir.add(findObject.objects().value(ids[j])->descriptors());
+			}
+			findObject.removeAllObjects();
+			UINFO("Images %d/%d, %lld descriptors extracted, %d kept", std::min(i+chunk, files.size()), files.size(), reservoir.seen(), reservoir.samples().rows);
+		}
+	}
+
+	const cv::Mat & samples = reservoir.samples();
+	if(samples.rows < words)
+	{
+		UERROR("Not enough descriptors (%d) to train %d words.", samples.rows, words);
+		return -1;
+	}
+	cv::Mat data = samples;
+	if(data.type() != CV_8U && data.type() != CV_32F)
+	{
+		samples.convertTo(data, CV_32F);
+	}
+
+	UINFO("Training %d words from %d descriptors (batch=%d, iterations=%d, threads=%d)...", words, data.rows, batchSize, iterations, threads);
+	cv::Mat vocabulary = trainVocabulary(data, words, batchSize, iterations, threads);
+
+	if(vocabulary.type() == CV_8U && find_object::Settings::getNearestNeighbor_7ConvertBinToFloat())
+	{
+		// same type than words of a vocabulary created with "NearestNeighbor/7ConvertBinToFloat"
+		vocabulary.convertTo(vocabulary, CV_32F);
+	}
+
+	// Same format than Vocabulary::save()
+	cv::FileStorage fs(outputPath.toStdString(), cv::FileStorage::WRITE);
+	if(!fs.isOpened())
+	{
+		UERROR("Failed to open vocabulary file \"%s\"", outputPath.toStdString().c_str());
+		return -1;
+	}
+	fs << "Descriptors" << vocabulary;
+	fs.release();
+	UINFO("Vocabulary of %d words saved to \"%s\" (%d ms)", vocabulary.rows, outputPath.toStdString().c_str(), totalTime.elapsed());
+
+	return 0;
+}